@@ -60,6 +60,11 @@ class AtomT
  
     std::string toString() const;
     std::string getAtomType() const;
+
+    // The constituent fields (as given to the constructor)
+    AtomEnumT getElement() const { return theAtomT.atomType; }
+    int getSpecificNum() const { return theAtomT.specificNum; }
+    SpecialEnumT getSpecial() const { return theAtomT.specialT; }
     friend std::ostream& operator<< (std::ostream& os, const AtomT& atomType);
     bool operator==(const AtomT& that) const;
     bool operator!=(const AtomT& that) const { return !(*this == that); }
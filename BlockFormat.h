@@ -0,0 +1,147 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BLOCK_FORMAT_GUARD
+#define _BLOCK_FORMAT_GUARD 1
+
+
+#include <string>
+#include <cstring>
+
+
+//
+// The seekable block container for synthesized molecules (.blk).
+//
+//    Header   : magic[8] "ESYNBLK1", version u32, encoding u32,
+//               records per block u32, fragment library hash u32
+//    Blocks   : independently compressed zlib streams of records
+//    Index    : one 32-byte entry per block (BlockIndexEntry)
+//    Trailer  : index offset u64, number of blocks u32, version u32,
+//               magic[8] "ESYNIDX1"
+//
+// All integers are little-endian. A reader locates the trailer at the end of
+// the file, then the index, and decompresses only the blocks it needs.
+//
+namespace BlockFormat
+{
+    static const char HEADER_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'B', 'L', 'K', '1' };
+    static const char TRAILER_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'I', 'D', 'X', '1' };
+
+    static const unsigned VERSION = 1;
+
+    static const unsigned HEADER_SIZE = 24;
+    static const unsigned INDEX_ENTRY_SIZE = 32;
+    static const unsigned TRAILER_SIZE = 24;
+
+    // Records within a block: newline-terminated text (SMILES)
+    static const unsigned ENCODING_TEXT = 0;
+
+    // Records within a block: varint length, then a fragment assembly (see Molecule::getAssembly)
+    static const unsigned ENCODING_ASSEMBLY = 1;
+
+    // Records per block when none is specified
+    static const unsigned DEFAULT_BLOCK_RECORDS = 8192;
+
+    static const char* const SUFFIX = ".blk";
+}
+
+struct BlockIndexEntry
+{
+    unsigned long long firstId;  // Id of the first molecule in the block (1-based, run-wide)
+    unsigned long long offset;   // Byte offset of the compressed block in the file
+    unsigned size;               // Compressed size in bytes
+    unsigned rawSize;            // Uncompressed size in bytes
+    unsigned count;              // Number of molecules in the block
+    unsigned char minLevel;      // Smallest and largest molecule level (# fragments) in the block
+    unsigned char maxLevel;
+};
+
+//
+// Little-endian encoding helpers
+//
+inline void PutU32(std::string& out, unsigned v)
+{
+    for (int b = 0; b < 4; b++) out += (char)((v >> (8 * b)) & 0xFF);
+}
+
+inline void PutU64(std::string& out, unsigned long long v)
+{
+    for (int b = 0; b < 8; b++) out += (char)((v >> (8 * b)) & 0xFF);
+}
+
+inline unsigned GetU32(const unsigned char* in)
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned)in[3] << 24);
+}
+
+inline unsigned long long GetU64(const unsigned char* in)
+{
+    return GetU32(in) | ((unsigned long long)GetU32(in + 4) << 32);
+}
+
+//
+// Unsigned LEB128: 7 bits per byte, high bit set on all but the last byte.
+//
+inline void PutVarint(std::string& out, unsigned v)
+{
+    while (v >= 0x80)
+    {
+        out += (char)((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+// Advances 'in'; false if the value runs past 'end'.
+inline bool GetVarint(const unsigned char*& in, const unsigned char* end, unsigned& v)
+{
+    v = 0;
+    for (unsigned shift = 0; in < end && shift < 32; shift += 7)
+    {
+        unsigned char byte = *in++;
+        v |= (unsigned)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+inline void EncodeIndexEntry(std::string& out, const BlockIndexEntry& entry)
+{
+    PutU64(out, entry.firstId);
+    PutU64(out, entry.offset);
+    PutU32(out, entry.size);
+    PutU32(out, entry.rawSize);
+    PutU32(out, entry.count);
+    out += (char)entry.minLevel;
+    out += (char)entry.maxLevel;
+    out += '\0';
+    out += '\0';
+}
+
+inline void DecodeIndexEntry(const unsigned char* in, BlockIndexEntry& entry)
+{
+    entry.firstId = GetU64(in);
+    entry.offset = GetU64(in + 8);
+    entry.size = GetU32(in + 16);
+    entry.rawSize = GetU32(in + 20);
+    entry.count = GetU32(in + 24);
+    entry.minLevel = in[28];
+    entry.maxLevel = in[29];
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "BlockReader.h"
+#include "zpipe.h"
+
+
+BlockReader::BlockReader() : data(0), size(0), encoding(0), library(0)
+{
+}
+
+BlockReader::~BlockReader()
+{
+    close();
+}
+
+bool BlockReader::open(const std::string& name)
+{
+    close();
+
+    fileName = name;
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Block file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    struct stat buffer;
+    if (fstat(fd, &buffer) != 0 ||
+        buffer.st_size < BlockFormat::HEADER_SIZE + BlockFormat::TRAILER_SIZE)
+    {
+        std::cerr << "Block file " << fileName << " is too short." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size = buffer.st_size;
+
+    void* mapped = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Block file " << fileName << " could not be mapped." << std::endl;
+        size = 0;
+        return false;
+    }
+
+    data = static_cast<const unsigned char*>(mapped);
+
+    //
+    // Verify the header and trailer
+    //
+    const unsigned char* trailer = data + size - BlockFormat::TRAILER_SIZE;
+
+    if (memcmp(data, BlockFormat::HEADER_MAGIC, sizeof(BlockFormat::HEADER_MAGIC)) != 0 ||
+        memcmp(trailer + 16, BlockFormat::TRAILER_MAGIC, sizeof(BlockFormat::TRAILER_MAGIC)) != 0)
+    {
+        std::cerr << "Block file " << fileName << " is incomplete or not a block file." << std::endl;
+        close();
+        return false;
+    }
+
+    if (GetU32(data + 8) != BlockFormat::VERSION)
+    {
+        std::cerr << "Block file " << fileName << " has unsupported version "
+                  << GetU32(data + 8) << "." << std::endl;
+        close();
+        return false;
+    }
+
+    encoding = GetU32(data + 12);
+    library = GetU32(data + 20);
+
+    //
+    // Acquire the index
+    //
+    unsigned long long indexOffset = GetU64(trailer);
+    unsigned count = GetU32(trailer + 8);
+
+    if (indexOffset < BlockFormat::HEADER_SIZE ||
+        indexOffset > size - BlockFormat::TRAILER_SIZE ||
+        indexOffset + (unsigned long long)count * BlockFormat::INDEX_ENTRY_SIZE !=
+        size - BlockFormat::TRAILER_SIZE)
+    {
+        std::cerr << "Block file " << fileName << " has a corrupt index." << std::endl;
+        close();
+        return false;
+    }
+
+    index.resize(count);
+    for (unsigned b = 0; b < count; b++)
+    {
+        DecodeIndexEntry(data + indexOffset + b * BlockFormat::INDEX_ENTRY_SIZE, index[b]);
+
+        //
+        // Every block must lie between the header and the index; readBlock
+        // trusts these extents when it inflates from the mapping.
+        //
+        const BlockIndexEntry& entry = index[b];
+        if (entry.offset < BlockFormat::HEADER_SIZE ||
+            entry.offset > indexOffset ||
+            entry.size > indexOffset - entry.offset)
+        {
+            std::cerr << "Block file " << fileName << " has a corrupt index entry "
+                      << b << "." << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void BlockReader::close()
+{
+    if (data != 0) munmap(const_cast<unsigned char*>(data), size);
+
+    data = 0;
+    size = 0;
+    index.clear();
+}
+
+unsigned long long BlockReader::firstId() const
+{
+    return index.empty() ? 0 : index[0].firstId;
+}
+
+unsigned long long BlockReader::lastId() const
+{
+    return index.empty() ? 0 : index.back().firstId + index.back().count - 1;
+}
+
+//
+// Blocks are in increasing id order; binary search on the first id.
+//
+int BlockReader::findBlock(unsigned long long id) const
+{
+    int low = 0;
+    int high = index.size() - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+
+        if (id < index[mid].firstId) high = mid - 1;
+        else if (id >= index[mid].firstId + index[mid].count) low = mid + 1;
+        else return mid;
+    }
+
+    return -1;
+}
+
+bool BlockReader::readBlock(unsigned b, std::vector<std::string>& records) const
+{
+    if (b >= index.size()) return false;
+
+    const BlockIndexEntry& entry = index[b];
+
+    std::string raw;
+    raw.reserve(entry.rawSize);
+
+    int ret = inf_buffer((const char*)data + entry.offset, entry.size, raw);
+    if (ret != 0)
+    {
+        std::cerr << "Block " << b << " of " << fileName << " could not be decompressed." << std::endl;
+        return false;
+    }
+
+    records.reserve(records.size() + entry.count);
+
+    //
+    // Binary records are length-prefixed.
+    //
+    if (encoding == BlockFormat::ENCODING_ASSEMBLY)
+    {
+        const unsigned char* p = (const unsigned char*)raw.data();
+        const unsigned char* end = p + raw.size();
+
+        while (p < end)
+        {
+            unsigned length;
+            if (!GetVarint(p, end, length) || length > (unsigned)(end - p))
+            {
+                std::cerr << "Block " << b << " of " << fileName << " has a truncated record." << std::endl;
+                return false;
+            }
+
+            records.push_back(std::string((const char*)p, length));
+            p += length;
+        }
+
+        return true;
+    }
+
+    // Text records are newline-terminated.
+    std::string::size_type start = 0;
+    std::string::size_type end;
+    while ((end = raw.find('\n', start)) != std::string::npos)
+    {
+        records.push_back(raw.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return true;
+}
+
+bool BlockReader::readMolecule(unsigned long long id, std::string& record) const
+{
+    int b = findBlock(id);
+    if (b < 0) return false;
+
+    std::vector<std::string> records;
+    if (!readBlock(b, records)) return false;
+
+    unsigned long long local = id - index[b].firstId;
+    if (local >= records.size()) return false;
+
+    record = records[local];
+
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BLOCK_READER_GUARD
+#define _BLOCK_READER_GUARD 1
+
+
+#include <string>
+#include <vector>
+
+
+#include "BlockFormat.h"
+
+
+//
+// Random access to a seekable block container (see BlockFormat.h).
+//
+// The file is memory-mapped; opening it reads only the trailer and index.
+// Individual blocks are decompressed on request, so separate readers (or
+// threads with their own reader) may consume disjoint blocks in parallel.
+//
+class BlockReader
+{
+  public:
+    BlockReader();
+    ~BlockReader();
+
+    // Map the file and load its index; false (with a message) if it is not a valid container.
+    bool open(const std::string& fileName);
+    void close();
+
+    unsigned numBlocks() const { return index.size(); }
+    unsigned getEncoding() const { return encoding; }
+    unsigned getLibrary() const { return library; }
+    const BlockIndexEntry& block(unsigned b) const { return index[b]; }
+
+    // Range of molecule ids held in this file; [first, last]
+    unsigned long long firstId() const;
+    unsigned long long lastId() const;
+
+    // The block containing the given molecule id; -1 if not in this file.
+    int findBlock(unsigned long long id) const;
+
+    // Decompress block b into its records (in id order); text records exclude the newline.
+    bool readBlock(unsigned b, std::vector<std::string>& records) const;
+
+    // Acquire a single molecule by id.
+    bool readMolecule(unsigned long long id, std::string& record) const;
+
+  private:
+    std::string fileName;
+    const unsigned char* data;
+    unsigned long long size;
+
+    unsigned encoding;
+    unsigned library;
+    std::vector<BlockIndexEntry> index;
+
+    // Not copyable.
+    BlockReader(const BlockReader&);
+    BlockReader& operator=(const BlockReader&);
+};
+
+#endif
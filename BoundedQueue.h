@@ -0,0 +1,210 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BOUNDED_QUEUE_GUARD
+#define _BOUNDED_QUEUE_GUARD 1
+
+
+#include <deque>
+#include <pthread.h>
+
+
+//
+// A multi-producer / multi-consumer FIFO queue with blocking push and pop.
+//
+// A capacity of 0 indicates the queue is limitless (push never blocks).
+// Once closed, push is refused and pop drains the remaining elements; pop
+// then returns false to indicate there is nothing left to consume.
+//
+template <class T>
+class BoundedQueue
+{
+  public:
+    BoundedQueue(unsigned capacity = 0) : capacity(capacity), closed(false)
+    {
+        pthread_mutex_init(&lock, NULL);
+        pthread_cond_init(&not_empty, NULL);
+        pthread_cond_init(&not_full, NULL);
+    }
+
+    ~BoundedQueue()
+    {
+        pthread_cond_destroy(&not_full);
+        pthread_cond_destroy(&not_empty);
+        pthread_mutex_destroy(&lock);
+    }
+
+    // Blocks while the queue is at capacity; false if the queue was closed.
+    bool push(const T& item);
+
+    // Blocks while the queue is empty and open; false if closed and drained.
+    bool pop(T& item);
+
+    // Non-blocking pop; false if there is currently nothing to take.
+    bool try_pop(T& item);
+
+    // No more elements will be produced; wake all waiting threads.
+    void close();
+
+    // Adjust the capacity; waiting producers are woken if room was made.
+    void set_capacity(unsigned cap);
+
+    unsigned size();
+    bool empty() { return size() == 0; }
+    bool is_closed();
+    unsigned get_capacity();
+
+  private:
+    std::deque<T> items;
+    unsigned capacity;
+    bool closed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    bool full() const { return capacity != 0 && items.size() >= capacity; }
+
+    // Not copyable.
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+};
+
+template <class T>
+bool BoundedQueue<T>::push(const T& item)
+{
+    pthread_mutex_lock(&lock);
+
+    while (!closed && full())
+    {
+        pthread_cond_wait(&not_full, &lock);
+    }
+
+    if (closed)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    items.push_back(item);
+
+    pthread_cond_signal(&not_empty);
+    pthread_mutex_unlock(&lock);
+
+    return true;
+}
+
+template <class T>
+bool BoundedQueue<T>::pop(T& item)
+{
+    pthread_mutex_lock(&lock);
+
+    while (!closed && items.empty())
+    {
+        pthread_cond_wait(&not_empty, &lock);
+    }
+
+    // Closed and drained.
+    if (items.empty())
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    item = items.front();
+    items.pop_front();
+
+    pthread_cond_signal(&not_full);
+    pthread_mutex_unlock(&lock);
+
+    return true;
+}
+
+template <class T>
+bool BoundedQueue<T>::try_pop(T& item)
+{
+    pthread_mutex_lock(&lock);
+
+    if (items.empty())
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    item = items.front();
+    items.pop_front();
+
+    pthread_cond_signal(&not_full);
+    pthread_mutex_unlock(&lock);
+
+    return true;
+}
+
+template <class T>
+void BoundedQueue<T>::close()
+{
+    pthread_mutex_lock(&lock);
+
+    closed = true;
+
+    pthread_cond_broadcast(&not_empty);
+    pthread_cond_broadcast(&not_full);
+    pthread_mutex_unlock(&lock);
+}
+
+template <class T>
+void BoundedQueue<T>::set_capacity(unsigned cap)
+{
+    pthread_mutex_lock(&lock);
+
+    capacity = cap;
+
+    pthread_cond_broadcast(&not_full);
+    pthread_mutex_unlock(&lock);
+}
+
+template <class T>
+unsigned BoundedQueue<T>::size()
+{
+    pthread_mutex_lock(&lock);
+    unsigned sz = items.size();
+    pthread_mutex_unlock(&lock);
+
+    return sz;
+}
+
+template <class T>
+bool BoundedQueue<T>::is_closed()
+{
+    pthread_mutex_lock(&lock);
+    bool c = closed;
+    pthread_mutex_unlock(&lock);
+
+    return c;
+}
+
+template <class T>
+unsigned BoundedQueue<T>::get_capacity()
+{
+    pthread_mutex_lock(&lock);
+    unsigned cap = capacity;
+    pthread_mutex_unlock(&lock);
+
+    return cap;
+}
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "Checkpoint.h"
+#include "BlockFormat.h"
+
+
+static const char CHECKPOINT_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'C', 'K', 'P', '1' };
+static const unsigned CHECKPOINT_VERSION = 3;
+
+const char* const Checkpoint::FILE_NAME = "checkpoint.esyn";
+
+volatile sig_atomic_t Checkpoint::requested = 0;
+volatile sig_atomic_t Checkpoint::stopRequested = 0;
+
+
+Checkpoint::Checkpoint() : file(0), data(0), size(0), offset(0), good(false)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    close();
+}
+
+// ****************************************************************************
+
+bool Checkpoint::create(const std::string& dir)
+{
+    close();
+
+    fileName = dir + "/" + FILE_NAME;
+    tempName = fileName + ".tmp";
+
+    file = fopen(tempName.c_str(), "wb");
+    if (file == 0)
+    {
+        std::cerr << "Checkpoint " << tempName << " could not be created." << std::endl;
+        return false;
+    }
+
+    good = true;
+
+    write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    putU32(CHECKPOINT_VERSION);
+
+    return good;
+}
+
+void Checkpoint::write(const void* bytes, unsigned long long n)
+{
+    if (!good || n == 0) return;
+
+    if (fwrite(bytes, 1, n, file) != n) good = false;
+}
+
+void Checkpoint::putU32(unsigned v)
+{
+    std::string bytes;
+    PutU32(bytes, v);
+    write(bytes.data(), bytes.size());
+}
+
+void Checkpoint::putU64(unsigned long long v)
+{
+    std::string bytes;
+    PutU64(bytes, v);
+    write(bytes.data(), bytes.size());
+}
+
+void Checkpoint::putBytes(const std::string& bytes)
+{
+    putU64(bytes.size());
+    write(bytes.data(), bytes.size());
+}
+
+void Checkpoint::putFilter(const PersistentBloomFilter& filter)
+{
+    putU32(filter.element_count());
+    putU64(filter.raw_size());
+    write(filter.table(), filter.raw_size());
+}
+
+//
+// The completed checkpoint replaces the previous one.
+//
+bool Checkpoint::commit()
+{
+    if (file == 0) return false;
+
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) good = false;
+
+    fclose(file);
+    file = 0;
+
+    if (good && rename(tempName.c_str(), fileName.c_str()) != 0) good = false;
+
+    if (!good)
+    {
+        std::cerr << "Checkpoint " << fileName << " could not be written." << std::endl;
+        remove(tempName.c_str());
+    }
+
+    return good;
+}
+
+// ****************************************************************************
+
+bool Checkpoint::open(const std::string& dir)
+{
+    close();
+
+    fileName = dir + "/" + FILE_NAME;
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Checkpoint " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    struct stat buffer;
+    if (fstat(fd, &buffer) != 0 || buffer.st_size < (off_t)sizeof(CHECKPOINT_MAGIC) + 4)
+    {
+        std::cerr << "Checkpoint " << fileName << " is too short." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size = buffer.st_size;
+
+    void* mapped = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Checkpoint " << fileName << " could not be mapped." << std::endl;
+        size = 0;
+        return false;
+    }
+
+    data = static_cast<const unsigned char*>(mapped);
+    offset = 0;
+    good = true;
+
+    if (memcmp(take(sizeof(CHECKPOINT_MAGIC)), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+        getU32() != CHECKPOINT_VERSION)
+    {
+        std::cerr << "Checkpoint " << fileName << " is not a supported checkpoint." << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// Advance over n bytes; 0 (and not ok) if they are not there.
+const unsigned char* Checkpoint::take(unsigned long long n)
+{
+    if (!good || size - offset < n)
+    {
+        good = false;
+        return 0;
+    }
+
+    const unsigned char* at = data + offset;
+    offset += n;
+    return at;
+}
+
+unsigned Checkpoint::getU32()
+{
+    const unsigned char* p = take(4);
+    return p ? GetU32(p) : 0;
+}
+
+unsigned long long Checkpoint::getU64()
+{
+    const unsigned char* p = take(8);
+    return p ? GetU64(p) : 0;
+}
+
+void Checkpoint::getBytes(std::string& bytes)
+{
+    unsigned long long n = getU64();
+    const unsigned char* p = take(n);
+
+    if (p) bytes.assign((const char*)p, n);
+    else bytes.clear();
+}
+
+void Checkpoint::getFilter(PersistentBloomFilter& filter)
+{
+    unsigned count = getU32();
+    unsigned long long n = getU64();
+
+    // The filter must have been created with the same parameters.
+    if (n != filter.raw_size()) good = false;
+
+    const unsigned char* p = take(n);
+    if (p) filter.restore(p, count);
+}
+
+void Checkpoint::close()
+{
+    if (file != 0)
+    {
+        fclose(file);
+        remove(tempName.c_str());
+        file = 0;
+    }
+
+    if (data != 0) munmap(const_cast<unsigned char*>(data), size);
+
+    data = 0;
+    size = 0;
+    offset = 0;
+    good = false;
+}
+
+// ****************************************************************************
+
+void Checkpoint::HandleSignal(int signal)
+{
+    if (signal != SIGUSR1) stopRequested = 1;
+
+    requested = 1;
+}
+
+void Checkpoint::InstallSignalHandlers()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Checkpoint::HandleSignal;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGUSR1, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    sigaction(SIGINT, &action, 0);
+}
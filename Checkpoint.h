@@ -0,0 +1,125 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHECKPOINT_GUARD
+#define _CHECKPOINT_GUARD 1
+
+
+#include <string>
+#include <cstdio>
+#include <csignal>
+
+
+#include "bloom_filter.hpp"
+
+
+//
+// A bloom filter whose bits can be saved to and restored from a checkpoint.
+//
+class PersistentBloomFilter : public bloom_filter
+{
+  public:
+    PersistentBloomFilter(const bloom_parameters& p) : bloom_filter(p) {}
+
+    unsigned long long raw_size() const { return raw_table_size_; }
+
+    void restore(const unsigned char* bits, unsigned count)
+    {
+        std::copy(bits, bits + raw_table_size_, bit_table_);
+        inserted_element_count_ = count;
+    }
+};
+
+
+//
+// A snapshot of a serial synthesis run (checkpoint.esyn in the checkpoint directory).
+//
+//    Header : magic[8] "ESYNCKP1", version u32
+//    Body   : a sequence of u32, u64, byte strings (u64 length, bytes), and
+//             bloom filters (element count u32, table size u64, table bytes)
+//
+// The order of the body is defined by the writer (Instantiator). A checkpoint
+// is written to a temporary file that replaces the previous one only once it
+// is complete, so an interruption while checkpointing loses nothing.
+//
+// Values are read back from the memory-mapped file; a short or corrupt file
+// leaves the reader not ok.
+//
+class Checkpoint
+{
+  public:
+    Checkpoint();
+    ~Checkpoint();
+
+    //
+    // Writing
+    //
+    bool create(const std::string& dir);
+    void putU32(unsigned v);
+    void putU64(unsigned long long v);
+    void putBytes(const std::string& bytes);
+    void putFilter(const PersistentBloomFilter& filter);
+    bool commit();
+
+    //
+    // Reading
+    //
+    bool open(const std::string& dir);
+    unsigned getU32();
+    unsigned long long getU64();
+    void getBytes(std::string& bytes);
+    void getFilter(PersistentBloomFilter& filter);
+    bool ok() const { return good; }
+    void close();
+
+    static const char* const FILE_NAME;
+
+    //
+    // SIGUSR1 requests a checkpoint; SIGTERM and SIGINT request a checkpoint
+    // and then an exit.
+    //
+    static void InstallSignalHandlers();
+    static bool Requested() { return requested != 0; }
+    static bool StopRequested() { return stopRequested != 0; }
+    static void ClearRequest() { requested = 0; }
+
+  private:
+    std::string fileName;
+    std::string tempName;
+
+    FILE* file;
+
+    const unsigned char* data;
+    unsigned long long size;
+    unsigned long long offset;
+
+    bool good;
+
+    void write(const void* bytes, unsigned long long n);
+    const unsigned char* take(unsigned long long n);
+
+    static volatile sig_atomic_t requested;
+    static volatile sig_atomic_t stopRequested;
+
+    static void HandleSignal(int signal);
+
+    // Not copyable.
+    Checkpoint(const Checkpoint&);
+    Checkpoint& operator=(const Checkpoint&);
+};
+
+#endif
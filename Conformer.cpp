@@ -0,0 +1,194 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "Conformer.h"
+#include "Molecule.h"
+#include "BlockFormat.h"
+#include "obgen.h"
+
+
+// Length of the (single) bond joining two fragments
+static const double BOND_LENGTH = 1.5;
+
+static const double EPSILON = 1.0e-6;
+
+
+//
+// Atoms bonded to the given atom within a fragment.
+//
+static void Neighbors(const std::vector<Bond>& bonds, unsigned atom, std::vector<unsigned>& neighbors)
+{
+    neighbors.clear();
+
+    for (unsigned b = 0; b < bonds.size(); b++)
+    {
+        if (bonds[b].getOriginAtomID() == atom) neighbors.push_back(bonds[b].getTargetAtomID());
+        else if (bonds[b].getTargetAtomID() == atom) neighbors.push_back(bonds[b].getOriginAtomID());
+    }
+}
+
+// ****************************************************************************
+
+//
+// The open valence points away from the atom's existing bonds; atoms with
+// none (or balanced bonds) take any direction perpendicular to them.
+//
+Point Conformer::OpenValence(const std::vector<Point>& coordinates,
+                             const std::vector<unsigned>& neighbors, unsigned atom)
+{
+    Point direction;
+    for (unsigned n = 0; n < neighbors.size(); n++)
+    {
+        Point bond = coordinates[atom] - coordinates[neighbors[n]];
+        double length = bond.length();
+
+        if (length > EPSILON) direction = direction + bond * (1.0 / length);
+    }
+
+    if (direction.length() < EPSILON)
+    {
+        if (neighbors.empty()) return Point(1, 0, 0);
+
+        Point bond = coordinates[atom] - coordinates[neighbors[0]];
+        direction = bond.cross(Point(1, 0, 0));
+        if (direction.length() < EPSILON) direction = bond.cross(Point(0, 1, 0));
+        if (direction.length() < EPSILON) return Point(1, 0, 0);
+    }
+
+    return direction * (1.0 / direction.length());
+}
+
+//
+// Rodrigues' rotation formula.
+//
+Point Conformer::Rotate(const Point& v, const Point& axis, double cosine, double sine)
+{
+    return v * cosine + axis.cross(v) * sine + axis * (axis.dot(v) * (1.0 - cosine));
+}
+
+// ****************************************************************************
+
+bool Conformer::Assemble(const std::string& assembly, std::vector<Point>& coordinates)
+{
+    const std::vector<Molecule*>& fragments = Molecule::baseMolecules;
+
+    const unsigned char* in = (const unsigned char*)assembly.data();
+    const unsigned char* end = in + assembly.size();
+
+    unsigned fragment;
+    if (!GetVarint(in, end, fragment) || fragment >= fragments.size()) return false;
+
+    const Molecule* base = fragments[fragment];
+    if (base->coordinates.empty() || base->coordinates.size() != base->atoms.size()) return false;
+
+    coordinates = base->coordinates;
+
+    // Bonds of the molecule laid out so far, for the open valence of its atoms
+    std::vector<Bond> bonds = base->bonds;
+
+    std::vector<unsigned> neighbors;
+    while (in < end)
+    {
+        unsigned thisAtom;
+        unsigned thatAtom;
+
+        if (!GetVarint(in, end, thisAtom) ||
+            !GetVarint(in, end, fragment) ||
+            !GetVarint(in, end, thatAtom) ||
+            fragment >= fragments.size() ||
+            thisAtom >= coordinates.size())
+        {
+            return false;
+        }
+
+        const Molecule& that = *fragments[fragment];
+        if (that.coordinates.empty() || that.coordinates.size() != that.atoms.size() ||
+            thatAtom >= that.coordinates.size())
+        {
+            return false;
+        }
+
+        Neighbors(bonds, thisAtom, neighbors);
+        Point toward = OpenValence(coordinates, neighbors, thisAtom);
+
+        Neighbors(that.bonds, thatAtom, neighbors);
+        Point from = OpenValence(that.coordinates, neighbors, thatAtom);
+
+        //
+        // Rotate that fragment so its open valence points back along the new bond.
+        //
+        Point facing = toward * -1.0;
+        Point axis = from.cross(facing);
+        double sine = axis.length();
+        double cosine = from.dot(facing);
+
+        if (sine > EPSILON) axis = axis * (1.0 / sine);
+        else if (cosine < 0)
+        {
+            // Opposite directions: a half turn about any perpendicular axis.
+            axis = from.cross(Point(1, 0, 0));
+            if (axis.length() < EPSILON) axis = from.cross(Point(0, 1, 0));
+            axis = axis * (1.0 / axis.length());
+            sine = 0;
+        }
+        else
+        {
+            axis = Point(1, 0, 0);
+            sine = 0;
+            cosine = 1;
+        }
+
+        //
+        // Place the connecting atom one bond length along the open valence.
+        //
+        Point anchor = coordinates[thisAtom] + toward * BOND_LENGTH;
+        const Point& pivot = that.coordinates[thatAtom];
+
+        unsigned offset = coordinates.size();
+        for (unsigned a = 0; a < that.coordinates.size(); a++)
+        {
+            coordinates.push_back(anchor + Rotate(that.coordinates[a] - pivot, axis, cosine, sine));
+        }
+
+        for (unsigned b = 0; b < that.bonds.size(); b++)
+        {
+            bonds.push_back(Bond(that.bonds[b], offset));
+        }
+        bonds.push_back(Bond(thisAtom, thatAtom + offset, 1));
+    }
+
+    return true;
+}
+
+// ****************************************************************************
+
+void Conformer::Write(const Molecule& mol, std::string& sdf)
+{
+    std::vector<Point> coordinates;
+    bool posed = Assemble(mol.getAssembly(), coordinates) &&
+                 coordinates.size() == (unsigned)mol.getNumberOfAtoms();
+
+    mol.WriteToOpenBabelFormat(sdf, posed ? &coordinates : 0);
+
+    // Without an obgen worker, the assembled (or blank) coordinates stand.
+    std::string minimized;
+    if (OBGen::Generate(sdf, posed, minimized)) sdf = minimized;
+}
@@ -0,0 +1,87 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONFORMER_GUARD
+#define _CONFORMER_GUARD 1
+
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+
+class Molecule;
+
+
+//
+// A position in space (Angstroms).
+//
+struct Point
+{
+    double x;
+    double y;
+    double z;
+
+    Point(double px = 0, double py = 0, double pz = 0) : x(px), y(py), z(pz) {}
+
+    Point operator+(const Point& that) const { return Point(x + that.x, y + that.y, z + that.z); }
+    Point operator-(const Point& that) const { return Point(x - that.x, y - that.y, z - that.z); }
+    Point operator*(double s) const { return Point(x * s, y * s, z * s); }
+
+    double dot(const Point& that) const { return x * that.x + y * that.y + z * that.z; }
+    Point cross(const Point& that) const
+    {
+        return Point(y * that.z - z * that.y, z * that.x - x * that.z, x * that.y - y * that.x);
+    }
+
+    double length() const { return sqrt(dot(*this)); }
+};
+
+
+//
+// 3D output from the docked poses of the fragments.
+//
+// The input rigids and linkers carry coordinates from docking. A synthesized
+// molecule is laid out by replaying its assembly (see Molecule::getAssembly):
+// each attached fragment is rotated so that its connecting atom's open valence
+// faces the new bond, then placed one bond length along it. A short force
+// field minimization (OBGen::Generate) relieves the joints.
+//
+class Conformer
+{
+  public:
+    // Coordinates for each atom of the assembly; false if a fragment has no pose.
+    static bool Assemble(const std::string& assembly, std::vector<Point>& coordinates);
+
+    //
+    // An SDF block of the molecule with minimized coordinates; molecules whose
+    // fragments have no pose are generated from scratch (also OBGen::Generate).
+    //
+    static void Write(const Molecule& mol, std::string& sdf);
+
+  private:
+    Conformer() {}
+
+    // Unit vector along which the open valence of an atom points.
+    static Point OpenValence(const std::vector<Point>& coordinates,
+                             const std::vector<unsigned>& neighbors, unsigned atom);
+
+    // Rotate v about the unit axis by the angle with the given cosine and sine.
+    static Point Rotate(const Point& v, const Point& axis, double cosine, double sine);
+};
+
+#endif
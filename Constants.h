@@ -25,6 +25,7 @@
 const unsigned int null = 0;
 
 const std::string COMPLIANT_EXE = "compliantwriter";
+const std::string OBGEN_EXE = "./synthobgen";
 
 const int NOT_FOUND = -1;
 
@@ -0,0 +1,83 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COUNTER_RNG_GUARD
+#define _COUNTER_RNG_GUARD 1
+
+
+#include <string>
+
+
+//
+// A counter-based random number generator: every draw is a pure function of
+// (seed, key, counter), so there is no state to share or lock between threads.
+// Keying a draw by a molecule's dedup SMI string makes the draw for that
+// molecule the same regardless of the thread that produced it.
+//
+class CounterRng
+{
+  public:
+    CounterRng(unsigned long long theSeed = 0) : seed(theSeed) {}
+
+    unsigned long long getSeed() const { return seed; }
+
+    // Uniform value in the open interval (0, 1) for the given key and counter.
+    double uniform(const std::string& key, unsigned long long counter = 0) const
+    {
+        return uniform(HashKey(key), counter);
+    }
+
+    double uniform(unsigned long long keyHash, unsigned long long counter = 0) const
+    {
+        unsigned long long bits = mix(mix(seed ^ keyHash) + counter * 0x9E3779B97F4A7C15ULL);
+
+        // 53 significant bits, offset by half a step to exclude 0.
+        return ((bits >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    //
+    // 64-bit FNV-1a hash of the key.
+    //
+    static unsigned long long HashKey(const std::string& key)
+    {
+        unsigned long long hash = 0xCBF29CE484222325ULL;
+
+        for (std::string::size_type c = 0; c < key.size(); c++)
+        {
+            hash ^= (unsigned char)key[c];
+            hash *= 0x100000001B3ULL;
+        }
+
+        return hash;
+    }
+
+  private:
+    unsigned long long seed;
+
+    //
+    // SplitMix64 finalizer: a bijective avalanche of the 64-bit input.
+    //
+    static unsigned long long mix(unsigned long long z)
+    {
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Descriptors.h"
+
+
+static const double HYDROGEN_MASS = 1.008;
+
+const double Descriptors::MAX_BOND_MOLWT_LOSS = 2 * HYDROGEN_MASS;
+const double Descriptors::MAX_BOND_HBD_LOSS = 2;
+const double Descriptors::MAX_BOND_HBA1_LOSS = 2;
+
+void Descriptors::add(const AtomT& type, const AtomState& state, int sign)
+{
+    // Hydrogens are counted with the atom they are attached to.
+    if (type.getElement() == ATOM_T_HYDROGEN) return;
+
+    MolWt += sign * (Mass(type.getElement()) + state.hydrogens * HYDROGEN_MASS);
+    HBD += sign * IsDonor(type, state);
+    HBA1 += sign * IsAcceptor(type, state);
+    logP += sign * LogP(type, state);
+}
+
+void Descriptors::bond(const AtomT& thisType, AtomState& thisState,
+                       const AtomT& thatType, AtomState& thatState)
+{
+    add(thisType, thisState, -1);
+    add(thatType, thatState, -1);
+
+    if (thisState.hydrogens > 0) thisState.hydrogens--;
+    if (thatState.hydrogens > 0) thatState.hydrogens--;
+    thisState.degree++;
+    thatState.degree++;
+
+    add(thisType, thisState);
+    add(thatType, thatState);
+}
+
+// ****************************************************************************
+
+double Descriptors::Mass(AtomEnumT element)
+{
+    switch (element)
+    {
+      case ATOM_T_CARBON:     return 12.011;
+      case ATOM_T_CHLORINE:   return 35.453;
+      case ATOM_T_HYDROGEN:   return HYDROGEN_MASS;
+      case ATOM_T_NITROGEN:   return 14.007;
+      case ATOM_T_OXYGEN:     return 15.999;
+      case ATOM_T_PHOSPHORUS: return 30.974;
+      case ATOM_T_SULFUR:     return 32.065;
+      case ATOM_T_FLUORINE:   return 18.998;
+      case ATOM_T_BROMINE:    return 79.904;
+      case ATOM_T_BORON:      return 10.811;
+      case ATOM_T_IODINE:     return 126.904;
+    }
+
+    return 0;
+}
+
+//
+// [!#6;!H0]: any hetero atom bearing a hydrogen.
+//
+bool Descriptors::IsDonor(const AtomT& type, const AtomState& state)
+{
+    return type.getElement() != ATOM_T_CARBON && state.hydrogens > 0;
+}
+
+//
+// [$([!#6;+0]);!$([F,Cl,Br,I]);!$([o,s,nX3]);!$([Nv5,Pv5,Sv4,Sv6])]:
+// a neutral hetero atom other than a halogen, an aromatic O or S, a three-connected
+// aromatic N, or a hypervalent N, P, or S (sulfoxides, sulfones, phosphates).
+//
+bool Descriptors::IsAcceptor(const AtomT& type, const AtomState& state)
+{
+    unsigned connections = state.degree + state.hydrogens;
+    bool aromatic = type.getSpecial() == SPECIAL_T_AROMATIC;
+
+    switch (type.getElement())
+    {
+      case ATOM_T_NITROGEN:
+        // N.4 is charged
+        if (type.getSpecificNum() == 4) return false;
+        return !(aromatic && connections >= 3);
+
+      case ATOM_T_OXYGEN:
+        // Carboxylates (O.co2) are drawn neutral in the fragments.
+        return !aromatic;
+
+      case ATOM_T_SULFUR:
+        // S.o / S.o2 are hypervalent.
+        return !aromatic && type.getSpecial() != SPECIAL_T_O;
+
+      case ATOM_T_PHOSPHORUS:
+        return connections <= 3;
+
+      case ATOM_T_BORON:
+        return true;
+    }
+
+    return false;
+}
+
+//
+// Atom and attached hydrogen contributions by type, after Wildman and Crippen
+// (J. Chem. Inf. Comput. Sci. 1999, 39, 868); neighbors beyond the atom itself
+// are not distinguished, so that a bond changes the two atoms bonded alone.
+//
+double Descriptors::LogP(const AtomT& type, const AtomState& state)
+{
+    bool aromatic = type.getSpecial() == SPECIAL_T_AROMATIC;
+    int hybrid = type.getSpecificNum();
+    unsigned h = state.hydrogens;
+
+    switch (type.getElement())
+    {
+      case ATOM_T_CARBON:
+      {
+        double carbon;
+        if (aromatic) carbon = h > 0 ? 0.1581 : 0.2713;
+        else if (hybrid == 3)
+        {
+            if (state.degree <= 1) carbon = 0.1441;
+            else if (state.degree == 2) carbon = 0.0000;
+            else if (state.degree == 3) carbon = -0.2035;
+            else carbon = -0.2051;
+        }
+        else if (hybrid == 1) carbon = 0.0000;
+        else carbon = h > 0 ? 0.1551 : 0.0845;
+
+        return carbon + h * 0.1230;
+      }
+
+      case ATOM_T_NITROGEN:
+      {
+        double nitrogen;
+        if (aromatic) nitrogen = h > 0 ? -0.3239 : -0.4806;
+        else if (hybrid == 4) nitrogen = -0.3396;
+        else if (hybrid == 1) nitrogen = -0.1643;
+        else if (hybrid == 2 && type.getSpecial() == SPECIAL_T_NONE) nitrogen = -0.4806;
+        else if (h >= 2) nitrogen = -1.0190;
+        else if (h == 1) nitrogen = -0.7096;
+        else nitrogen = -0.3187;
+
+        return nitrogen + h * 0.2142;
+      }
+
+      case ATOM_T_OXYGEN:
+      {
+        double oxygen;
+        if (aromatic) oxygen = 0.1552;
+        else if (hybrid == 3 && type.getSpecial() == SPECIAL_T_NONE) oxygen = h > 0 ? -0.2893 : -0.0684;
+        else if (type.getSpecial() == SPECIAL_T_CO) oxygen = -0.5000;
+        else oxygen = -0.1526;
+
+        return oxygen + h * 0.2980;
+      }
+
+      case ATOM_T_SULFUR:
+        if (type.getSpecial() == SPECIAL_T_O) return -0.0024;
+        return (aromatic ? 0.6237 : 0.6482) + h * 0.2980;
+
+      case ATOM_T_PHOSPHORUS: return 0.8612 + h * 0.2980;
+      case ATOM_T_FLUORINE:   return 0.4202;
+      case ATOM_T_CHLORINE:   return 0.6895;
+      case ATOM_T_BROMINE:    return 0.8456;
+      case ATOM_T_IODINE:     return 0.8857;
+      case ATOM_T_BORON:      return -0.1000 + h * 0.1230;
+    }
+
+    return 0;
+}
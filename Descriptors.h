@@ -0,0 +1,80 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DESCRIPTORS_GUARD
+#define _DESCRIPTORS_GUARD 1
+
+
+#include <vector>
+
+
+#include "AtomT.h"
+
+
+//
+// The hydrogen and heavy-atom neighbor counts of an atom; with its type these
+// determine the atom's contribution to each descriptor.
+//
+struct AtomState
+{
+    unsigned char hydrogens;
+    unsigned char degree;
+
+    AtomState(unsigned h = 0, unsigned d = 0) : hydrogens(h), degree(d) {}
+};
+
+//
+// Lipinski descriptors by atom contribution: molecular weight, hydrogen bond
+// donors (HBD), acceptors (HBA1), and a Crippen-style logP.
+//
+// Every heavy atom contributes by its Sybyl type and its state; hydrogens count
+// with the atom they are attached to. A fragment is summed once. Composition
+// adds a single bond, taking a hydrogen from each of the two atoms bonded, so
+// the descriptors of the product are those of its parts corrected at those two
+// atoms only.
+//
+// The donor and acceptor rules follow the OpenBabel HBD and HBA1 patterns.
+//
+class Descriptors
+{
+  public:
+    double MolWt;
+    double HBD;
+    double HBA1;
+    double logP;
+
+    Descriptors() : MolWt(0), HBD(0), HBA1(0), logP(0) {}
+
+    // Include (or, with a sign of -1, remove) the contribution of an atom.
+    void add(const AtomT& type, const AtomState& state, int sign = 1);
+
+    // A single bond between two atoms: update their contributions and states.
+    void bond(const AtomT& thisType, AtomState& thisState,
+              const AtomT& thatType, AtomState& thatState);
+
+    // A bond removes at most one hydrogen, one donor and one acceptor per atom.
+    static const double MAX_BOND_MOLWT_LOSS;
+    static const double MAX_BOND_HBD_LOSS;
+    static const double MAX_BOND_HBA1_LOSS;
+
+    static double Mass(AtomEnumT element);
+    static bool IsDonor(const AtomT& type, const AtomState& state);
+    static bool IsAcceptor(const AtomT& type, const AtomState& state);
+    static double LogP(const AtomT& type, const AtomState& state);
+};
+
+#endif
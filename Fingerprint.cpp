@@ -0,0 +1,498 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+
+#include "Fingerprint.h"
+#include "Molecule.h"
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+  #define FINGERPRINT_X86 1
+  #include <immintrin.h>
+
+  #if __GNUC__ >= 8
+    #define FINGERPRINT_AVX512 1
+  #endif
+#endif
+
+
+typedef unsigned long long u64;
+
+//
+// Hash combination and finalization (MurmurHash3 fmix32).
+//
+static unsigned Combine(unsigned h, unsigned value)
+{
+    return h ^ (value + 0x9e3779b9 + (h << 6) + (h >> 2));
+}
+
+static unsigned Finalize(unsigned h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static void SetBit(u64* fp, unsigned id)
+{
+    unsigned bit = Finalize(id) % Fingerprint::BITS;
+    fp[bit / 64] |= 1ULL << (bit % 64);
+}
+
+typedef std::vector<std::vector<std::pair<unsigned, unsigned> > > Adjacency;
+
+//
+// Elements are those of the atom types (AtomT.h); any other element is unknown.
+//
+static unsigned AtomicNumber(AtomEnumT element)
+{
+    switch (element)
+    {
+      case ATOM_T_HYDROGEN:   return 1;
+      case ATOM_T_BORON:      return 5;
+      case ATOM_T_CARBON:     return 6;
+      case ATOM_T_NITROGEN:   return 7;
+      case ATOM_T_OXYGEN:     return 8;
+      case ATOM_T_FLUORINE:   return 9;
+      case ATOM_T_PHOSPHORUS: return 15;
+      case ATOM_T_SULFUR:     return 16;
+      case ATOM_T_CHLORINE:   return 17;
+      case ATOM_T_BROMINE:    return 35;
+      case ATOM_T_IODINE:     return 53;
+    }
+
+    return 0;
+}
+
+static unsigned KnownAtomicNumber(unsigned atomicNumber)
+{
+    switch (atomicNumber)
+    {
+      case 1: case 5: case 6: case 7: case 8: case 9:
+      case 15: case 16: case 17: case 35: case 53:
+        return atomicNumber;
+    }
+
+    return 0;
+}
+
+static unsigned Seed(unsigned atomicNumber, unsigned degree, unsigned hydrogens, bool aromatic)
+{
+    unsigned id = Combine(0, atomicNumber);
+    id = Combine(id, degree);
+    id = Combine(id, hydrogens);
+    return Combine(id, aromatic);
+}
+
+// A bond between two aromatic atoms is labeled 4, whatever its Kekule order.
+static void Connect(Adjacency& neighbors, const std::vector<bool>& aromatic,
+                    unsigned begin, unsigned end, unsigned order)
+{
+    if (aromatic[begin] && aromatic[end]) order = 4;
+
+    neighbors[begin].push_back(std::make_pair(order, end));
+    neighbors[end].push_back(std::make_pair(order, begin));
+}
+
+//
+// Set the bits of the seeds and of every environment up to RADIUS bonds.
+//
+static void Extend(std::vector<unsigned>& ids, const Adjacency& neighbors, u64* fp)
+{
+    for (unsigned a = 0; a < ids.size(); a++) SetBit(fp, ids[a]);
+
+    std::vector<unsigned> next(ids.size());
+    std::vector<std::pair<unsigned, unsigned> > environment;
+
+    for (unsigned round = 1; round <= Fingerprint::RADIUS; round++)
+    {
+        for (unsigned a = 0; a < ids.size(); a++)
+        {
+            environment.clear();
+            for (unsigned n = 0; n < neighbors[a].size(); n++)
+            {
+                environment.push_back(std::make_pair(neighbors[a][n].first, ids[neighbors[a][n].second]));
+            }
+            std::sort(environment.begin(), environment.end());
+
+            unsigned id = Combine(round, ids[a]);
+            for (unsigned n = 0; n < environment.size(); n++)
+            {
+                id = Combine(Combine(id, environment[n].first), environment[n].second);
+            }
+
+            next[a] = id;
+            SetBit(fp, id);
+        }
+
+        ids.swap(next);
+    }
+}
+
+void Fingerprint::Compute(OpenBabel::OBMol& mol, u64* fp)
+{
+    memset(fp, 0, WORDS * sizeof(u64));
+
+    //
+    // Heavy atoms (OpenBabel indices are 1-based) and their seeds
+    //
+    std::vector<int> heavy(mol.NumAtoms() + 1, -1);
+    std::vector<unsigned> ids;
+    std::vector<bool> aromatic;
+
+    for (unsigned a = 1; a <= mol.NumAtoms(); a++)
+    {
+        OpenBabel::OBAtom* atom = mol.GetAtom(a);
+        if (atom->IsHydrogen()) continue;
+
+        heavy[a] = ids.size();
+        aromatic.push_back(atom->IsAromatic());
+        ids.push_back(Seed(KnownAtomicNumber(atom->GetAtomicNum()),
+                           atom->GetHvyValence(),
+                           atom->ImplicitHydrogenCount() + atom->ExplicitHydrogenCount(),
+                           atom->IsAromatic()));
+    }
+
+    //
+    // Heavy-atom adjacency, labeled by bond order
+    //
+    Adjacency neighbors(ids.size());
+
+    for (unsigned b = 0; b < mol.NumBonds(); b++)
+    {
+        OpenBabel::OBBond* bond = mol.GetBond(b);
+
+        int begin = heavy[bond->GetBeginAtomIdx()];
+        int end = heavy[bond->GetEndAtomIdx()];
+        if (begin < 0 || end < 0) continue;
+
+        Connect(neighbors, aromatic, begin, end, bond->GetBondOrder());
+    }
+
+    Extend(ids, neighbors, fp);
+}
+
+//
+// The seeds come from the fragments' atom types and the hydrogen and degree
+// states, which composition keeps current at the two atoms of each new bond;
+// the environments follow the fragment bonds and the composition bonds alike.
+// No Open Babel molecule is needed.
+//
+void Fingerprint::Compute(const Molecule& mol, u64* fp)
+{
+    memset(fp, 0, WORDS * sizeof(u64));
+
+    std::vector<int> heavy(mol.atoms.size(), -1);
+    std::vector<unsigned> ids;
+    std::vector<bool> aromatic;
+
+    for (unsigned a = 0; a < mol.atoms.size() && a < mol.atomStates.size(); a++)
+    {
+        const AtomT& type = mol.atoms[a]->getAtomType();
+        if (type.getElement() == ATOM_T_HYDROGEN) continue;
+
+        bool isAromatic = type.getSpecial() == SPECIAL_T_AROMATIC;
+
+        heavy[a] = ids.size();
+        aromatic.push_back(isAromatic);
+        ids.push_back(Seed(AtomicNumber(type.getElement()),
+                           mol.atomStates[a].degree,
+                           mol.atomStates[a].hydrogens,
+                           isAromatic));
+    }
+
+    Adjacency neighbors(ids.size());
+
+    for (unsigned b = 0; b < mol.bonds.size(); b++)
+    {
+        const Bond& bond = mol.bonds[b];
+
+        unsigned origin = bond.getOriginAtomID();
+        unsigned target = bond.getTargetAtomID();
+        if (origin >= heavy.size() || target >= heavy.size()) continue;
+
+        int begin = heavy[origin];
+        int end = heavy[target];
+        if (begin < 0 || end < 0) continue;
+
+        Connect(neighbors, aromatic, begin, end, bond.getOrder());
+    }
+
+    Extend(ids, neighbors, fp);
+}
+
+// ****************************************************************************
+
+//
+// Intersection kernels: for each of numRows fingerprints (contiguous, WORDS words
+// apiece), the number of bits it shares with the query.
+//
+typedef void (*IntersectionKernel)(const u64* query, const u64* rows, unsigned numRows, unsigned* counts);
+
+static void IntersectScalar(const u64* query, const u64* rows, unsigned numRows, unsigned* counts)
+{
+    for (unsigned r = 0; r < numRows; r++, rows += Fingerprint::WORDS)
+    {
+        unsigned count = 0;
+        for (unsigned w = 0; w < Fingerprint::WORDS; w++)
+        {
+            u64 v = query[w] & rows[w];
+
+            v = v - ((v >> 1) & 0x5555555555555555ULL);
+            v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+            count += (v * 0x0101010101010101ULL) >> 56;
+        }
+
+        counts[r] = count;
+    }
+}
+
+#ifdef FINGERPRINT_X86
+
+__attribute__((target("popcnt")))
+static void IntersectPopcnt(const u64* query, const u64* rows, unsigned numRows, unsigned* counts)
+{
+    for (unsigned r = 0; r < numRows; r++, rows += Fingerprint::WORDS)
+    {
+        unsigned count = 0;
+        for (unsigned w = 0; w < Fingerprint::WORDS; w++)
+        {
+            count += __builtin_popcountll(query[w] & rows[w]);
+        }
+
+        counts[r] = count;
+    }
+}
+
+//
+// Nibble lookup with a byte shuffle, summed per row with SAD (Mula, Kurz, and Lemire).
+//
+__attribute__((target("avx2")))
+static void IntersectAVX2(const u64* query, const u64* rows, unsigned numRows, unsigned* counts)
+{
+    static const unsigned VECTORS = Fingerprint::WORDS / 4;
+
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i q[VECTORS];
+    for (unsigned v = 0; v < VECTORS; v++)
+    {
+        q[v] = _mm256_loadu_si256((const __m256i*)(query + 4 * v));
+    }
+
+    for (unsigned r = 0; r < numRows; r++, rows += Fingerprint::WORDS)
+    {
+        // At most 8 bits per byte per vector; no byte overflows.
+        __m256i bytes = zero;
+        for (unsigned v = 0; v < VECTORS; v++)
+        {
+            __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(rows + 4 * v)), q[v]);
+            __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, nibble));
+            __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+            bytes = _mm256_add_epi8(bytes, _mm256_add_epi8(low, high));
+        }
+
+        __m256i sums = _mm256_sad_epu8(bytes, zero);
+        counts[r] = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                    _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+}
+
+#ifdef FINGERPRINT_AVX512
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void IntersectAVX512(const u64* query, const u64* rows, unsigned numRows, unsigned* counts)
+{
+    static const unsigned VECTORS = Fingerprint::WORDS / 8;
+
+    __m512i q[VECTORS];
+    for (unsigned v = 0; v < VECTORS; v++)
+    {
+        q[v] = _mm512_loadu_si512((const void*)(query + 8 * v));
+    }
+
+    for (unsigned r = 0; r < numRows; r++, rows += Fingerprint::WORDS)
+    {
+        __m512i sums = _mm512_setzero_si512();
+        for (unsigned v = 0; v < VECTORS; v++)
+        {
+            __m512i x = _mm512_and_si512(_mm512_loadu_si512((const void*)(rows + 8 * v)), q[v]);
+            sums = _mm512_add_epi64(sums, _mm512_popcnt_epi64(x));
+        }
+
+        counts[r] = _mm512_reduce_add_epi64(sums);
+    }
+}
+
+#endif
+#endif
+
+//
+// The widest kernel this processor supports, chosen once at startup.
+//
+struct KernelChoice
+{
+    IntersectionKernel kernel;
+    const char* name;
+
+    KernelChoice() : kernel(IntersectScalar), name("scalar")
+    {
+#ifdef FINGERPRINT_X86
+        __builtin_cpu_init();
+
+  #ifdef FINGERPRINT_AVX512
+        if (__builtin_cpu_supports("avx512vpopcntdq"))
+        {
+            kernel = IntersectAVX512;
+            name = "avx512";
+            return;
+        }
+  #endif
+        if (__builtin_cpu_supports("avx2"))
+        {
+            kernel = IntersectAVX2;
+            name = "avx2";
+        }
+        else if (__builtin_cpu_supports("popcnt"))
+        {
+            kernel = IntersectPopcnt;
+            name = "popcnt";
+        }
+#endif
+    }
+};
+
+static const KernelChoice choice;
+
+const char* Fingerprint::Kernel()
+{
+    return choice.name;
+}
+
+unsigned Fingerprint::Count(const u64* fp)
+{
+    unsigned count;
+    choice.kernel(fp, fp, 1, &count);
+    return count;
+}
+
+double Fingerprint::Tanimoto(const u64* fp1, const u64* fp2)
+{
+    unsigned shared;
+    choice.kernel(fp1, fp2, 1, &shared);
+
+    unsigned total = Count(fp1) + Count(fp2) - shared;
+    return total == 0 ? 0.0 : (double)shared / total;
+}
+
+// ****************************************************************************
+
+void FingerprintIndex::add(const u64* fp, const std::string& name)
+{
+    Bucket& bucket = buckets[Fingerprint::Count(fp)];
+
+    bucket.words.insert(bucket.words.end(), fp, fp + Fingerprint::WORDS);
+    bucket.rows.push_back(names.size());
+    names.push_back(name);
+}
+
+void FingerprintIndex::add(OpenBabel::OBMol& mol)
+{
+    u64 fp[Fingerprint::WORDS];
+    Fingerprint::Compute(mol, fp);
+
+    add(fp, mol.GetTitle());
+}
+
+//
+// Tanimoto bound of fingerprints with a and b bits set.
+//
+static double Bound(unsigned a, unsigned b)
+{
+    if (a == 0 && b == 0) return 0;
+
+    return a < b ? (double)a / b : (double)b / a;
+}
+
+double FingerprintIndex::best(const u64* query, int& row) const
+{
+    double best = -1;
+    row = -1;
+
+    //
+    // Walk outward from the bucket of the query's own count, taking the side with
+    // the larger bound; both sides only decrease.
+    //
+    unsigned queryCount = Fingerprint::Count(query);
+    int below = queryCount;
+    int above = queryCount + 1;
+
+    while (below >= 0 || above <= (int)Fingerprint::BITS)
+    {
+        double belowBound = below >= 0 ? Bound(queryCount, below) : -1;
+        double aboveBound = above <= (int)Fingerprint::BITS ? Bound(queryCount, above) : -1;
+
+        // A row with an equal coefficient would not replace the best.
+        if (std::max(belowBound, aboveBound) <= best) break;
+
+        if (belowBound >= aboveBound) search(query, queryCount, below--, best, row);
+        else search(query, queryCount, above++, best, row);
+    }
+
+    return best;
+}
+
+void FingerprintIndex::search(const u64* query, unsigned queryCount, unsigned count,
+                              double& best, int& row) const
+{
+    static const unsigned CHUNK = 1024;
+
+    const Bucket& bucket = buckets[count];
+    unsigned shared[CHUNK];
+
+    for (unsigned start = 0; start < bucket.rows.size(); start += CHUNK)
+    {
+        unsigned n = std::min(CHUNK, (unsigned)bucket.rows.size() - start);
+        choice.kernel(query, &bucket.words[start * Fingerprint::WORDS], n, shared);
+
+        for (unsigned r = 0; r < n; r++)
+        {
+            unsigned total = queryCount + count - shared[r];
+            double tanimoto = total == 0 ? 0.0 : (double)shared[r] / total;
+
+            // Among the rows visited, ties go to the row added first.
+            if (tanimoto > best || (tanimoto == best && (int)bucket.rows[start + r] < row))
+            {
+                best = tanimoto;
+                row = bucket.rows[start + r];
+            }
+        }
+    }
+}
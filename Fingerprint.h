@@ -0,0 +1,101 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _FINGERPRINT_GUARD
+#define _FINGERPRINT_GUARD 1
+
+
+#include <string>
+#include <vector>
+
+
+#include <openbabel/mol.h>
+
+
+class Molecule;
+
+
+//
+// Circular (Morgan-style) fingerprints of the heavy-atom graph.
+//
+// Each atom begins with an identifier from its element, heavy degree, hydrogen
+// count, and aromaticity; for RADIUS rounds the identifier is rehashed with the
+// sorted (bond, identifier) pairs of its neighbors, a bond between aromatic atoms
+// labeled 4. Every identifier from every round sets one of BITS bits. Only what
+// a synthesized Molecule records is used, so the fingerprint of a Molecule and
+// of the same structure read by Open Babel agree.
+//
+class Fingerprint
+{
+  public:
+    static const unsigned BITS = 1024;
+    static const unsigned WORDS = BITS / 64;
+    static const unsigned RADIUS = 2;
+
+    // Fill WORDS words with the fingerprint of the molecule.
+    static void Compute(OpenBabel::OBMol& mol, unsigned long long* fp);
+    static void Compute(const Molecule& mol, unsigned long long* fp);
+
+    static unsigned Count(const unsigned long long* fp);
+    static double Tanimoto(const unsigned long long* fp1, const unsigned long long* fp2);
+
+    // Name of the popcount kernel selected for this processor.
+    static const char* Kernel();
+};
+
+//
+// Fingerprints bucketed by bit count, each bucket stored contiguously.
+//
+// Two fingerprints with a and b bits set have a Tanimoto coefficient of at most
+// min(a, b) / max(a, b) (Swamidass and Baldi, BitBound). A query visits buckets
+// in decreasing order of that bound and stops once no bucket can beat the best
+// coefficient found, so most of a large index is never read.
+//
+// Adding is not synchronized with queries; queries may run concurrently.
+//
+class FingerprintIndex
+{
+  public:
+    FingerprintIndex() : buckets(Fingerprint::BITS + 1) {}
+
+    // Rows are numbered in the order added.
+    void add(const unsigned long long* fp, const std::string& name);
+    void add(OpenBabel::OBMol& mol);
+
+    unsigned size() const { return names.size(); }
+    bool empty() const { return names.empty(); }
+    const std::string& name(unsigned r) const { return names[r]; }
+
+    // The largest Tanimoto coefficient of the query against the index, and its row;
+    // -1 (and row -1) if the index is empty.
+    double best(const unsigned long long* query, int& row) const;
+
+  private:
+    struct Bucket
+    {
+        std::vector<unsigned long long> words;
+        std::vector<unsigned> rows;
+    };
+
+    std::vector<Bucket> buckets;
+    std::vector<std::string> names;
+
+    // Search one bucket of fingerprints with count bits set.
+    void search(const unsigned long long* query, unsigned queryCount, unsigned count,
+                double& best, int& row) const;
+};
+
+#endif
@@ -0,0 +1,444 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "FragmentLibrary.h"
+#include "BlockFormat.h"
+#include "Molecule.h"
+#include "Rigid.h"
+#include "Linker.h"
+#include "Atom.h"
+#include "LinkerConnectableAtom.h"
+#include "RigidConnectableAtom.h"
+
+
+static const char LIBRARY_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'L', 'I', 'B', '1' };
+static const unsigned LIBRARY_VERSION = 3;
+
+static const unsigned char ATOM_SIMPLE = 0;
+static const unsigned char ATOM_LINKER = 1;
+static const unsigned char ATOM_RIGID = 2;
+
+const char* const FragmentLibrary::SUFFIX = ".lib";
+
+
+struct FragmentLibrary::Input
+{
+    const unsigned char* in;
+    const unsigned char* end;
+    bool ok;
+
+    Input(const unsigned char* b, const unsigned char* e) : in(b), end(e), ok(true) {}
+
+    // Advance over n bytes; 0 (and not ok) if they are not there.
+    const unsigned char* take(unsigned n)
+    {
+        if (!ok || (unsigned long long)(end - in) < n)
+        {
+            ok = false;
+            return 0;
+        }
+
+        const unsigned char* at = in;
+        in += n;
+        return at;
+    }
+
+    unsigned u8() { const unsigned char* p = take(1); return p ? p[0] : 0; }
+    unsigned u16() { const unsigned char* p = take(2); return p ? p[0] | (p[1] << 8) : 0; }
+    unsigned u32() { const unsigned char* p = take(4); return p ? GetU32(p) : 0; }
+    unsigned long long u64() { const unsigned char* p = take(8); return p ? GetU64(p) : 0; }
+
+    double f64()
+    {
+        unsigned long long bits = u64();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+};
+
+static void PutF64(std::string& out, double v)
+{
+    unsigned long long bits;
+    memcpy(&bits, &v, sizeof(bits));
+    PutU64(out, bits);
+}
+
+static void PutU16(std::string& out, unsigned v)
+{
+    out += (char)(v & 0xFF);
+    out += (char)((v >> 8) & 0xFF);
+}
+
+// ****************************************************************************
+
+void FragmentLibrary::EncodeAtomType(std::string& out, const AtomT& type)
+{
+    out += (char)type.getElement();
+    PutU16(out, (unsigned short)type.getSpecificNum());
+    out += (char)type.getSpecial();
+}
+
+AtomT FragmentLibrary::DecodeAtomType(Input& in)
+{
+    AtomEnumT element = in.u8();
+    int number = (short)in.u16();
+    SpecialEnumT special = in.u8();
+
+    return AtomT(element, number, special);
+}
+
+void FragmentLibrary::EncodeFragment(std::string& out, const Molecule& fragment)
+{
+    PutU32(out, fragment.atoms.size());
+    PutU32(out, fragment.bonds.size());
+
+    PutF64(out, fragment.MolWt);
+    PutF64(out, fragment.HBD);
+    PutF64(out, fragment.HBA1);
+    PutF64(out, fragment.logP);
+
+    for (unsigned a = 0; a < fragment.atoms.size(); a++)
+    {
+        const Atom& atom = *fragment.atoms[a];
+        AtomState state = a < fragment.atomStates.size() ? fragment.atomStates[a] : AtomState();
+
+        if (atom.IsSimple())
+        {
+            out += (char)ATOM_SIMPLE;
+            EncodeAtomType(out, atom.getAtomType());
+            out += (char)state.hydrogens;
+            out += (char)state.degree;
+            continue;
+        }
+
+        out += (char)(atom.IsLinkerAtom() ? ATOM_LINKER : ATOM_RIGID);
+        EncodeAtomType(out, atom.getAtomType());
+        out += (char)state.hydrogens;
+        out += (char)state.degree;
+        out += (char)atom.getMaxConnect();
+        PutU32(out, atom.getConnectionID());
+
+        if (atom.IsRigidAtom())
+        {
+            const RigidConnectableAtom& rAtom = static_cast<const RigidConnectableAtom&>(atom);
+
+            out += (char)rAtom.getNumAllowableTypes();
+            for (unsigned t = 0; t < rAtom.getNumAllowableTypes(); t++)
+            {
+                EncodeAtomType(out, *rAtom.getAllowableTypes()[t]);
+            }
+        }
+    }
+
+    foreach_bonds(b_it, fragment.bonds)
+    {
+        PutU16(out, b_it->getOriginAtomID());
+        PutU16(out, b_it->getTargetAtomID());
+        out += (char)b_it->getOrder();
+    }
+
+    PutU32(out, fragment.coordinates.size());
+    for (unsigned a = 0; a < fragment.coordinates.size(); a++)
+    {
+        PutF64(out, fragment.coordinates[a].x);
+        PutF64(out, fragment.coordinates[a].y);
+        PutF64(out, fragment.coordinates[a].z);
+    }
+}
+
+bool FragmentLibrary::DecodeFragment(Input& in, Molecule& fragment)
+{
+    unsigned numAtoms = in.u32();
+    unsigned numBonds = in.u32();
+
+    fragment.MolWt = in.f64();
+    fragment.HBD = in.f64();
+    fragment.HBA1 = in.f64();
+    fragment.logP = in.f64();
+
+    fragment.uniqueIndexID = -1;
+    fragment.fingerprint = 0;
+
+    for (unsigned a = 0; a < numAtoms && in.ok; a++)
+    {
+        unsigned kind = in.u8();
+        AtomT type = DecodeAtomType(in);
+
+        unsigned hydrogens = in.u8();
+        unsigned degree = in.u8();
+        fragment.atomStates.push_back(AtomState(hydrogens, degree));
+
+        if (kind == ATOM_SIMPLE)
+        {
+            fragment.atoms.push_back(new Atom(type));
+            continue;
+        }
+
+        int maxConnect = in.u8();
+        unsigned connectionID = in.u32();
+
+        Atom* atom = 0;
+        if (kind == ATOM_LINKER && fragment.IsLinker())
+        {
+            atom = new LinkerConnectableAtom(maxConnect, type, static_cast<Linker*>(&fragment));
+        }
+        else if (kind == ATOM_RIGID && fragment.IsRigid())
+        {
+            std::vector<AtomT> allowed;
+            for (unsigned t = in.u8(); t > 0; t--)
+            {
+                allowed.push_back(DecodeAtomType(in));
+            }
+
+            atom = new RigidConnectableAtom(type, static_cast<Rigid*>(&fragment), allowed);
+        }
+        else
+        {
+            in.ok = false;
+            break;
+        }
+
+        atom->setConnectionID(connectionID);
+        fragment.atoms.push_back(atom);
+    }
+
+    for (unsigned b = 0; b < numBonds && in.ok; b++)
+    {
+        unsigned origin = in.u16();
+        unsigned target = in.u16();
+        unsigned order = in.u8();
+
+        if (origin >= numAtoms || target >= numAtoms) in.ok = false;
+        else fragment.bonds.push_back(Bond(origin, target, order));
+    }
+
+    unsigned numCoordinates = in.u32();
+    if (numCoordinates != 0 && numCoordinates != numAtoms) in.ok = false;
+
+    for (unsigned a = 0; a < numCoordinates && in.ok; a++)
+    {
+        double x = in.f64();
+        double y = in.f64();
+        double z = in.f64();
+
+        fragment.coordinates.push_back(Point(x, y, z));
+    }
+
+    return in.ok;
+}
+
+// ****************************************************************************
+
+bool FragmentLibrary::Write(const std::string& fileName,
+                            const std::vector<std::string>& inputs,
+                            const std::vector<Rigid*>& rigids,
+                            const std::vector<Linker*>& linkers)
+{
+    std::string out(LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC));
+    PutU32(out, LIBRARY_VERSION);
+    PutU32(out, rigids.size());
+    PutU32(out, linkers.size());
+    PutU32(out, inputs.size());
+
+    for (unsigned f = 0; f < inputs.size(); f++)
+    {
+        struct stat buffer;
+        if (stat(inputs[f].c_str(), &buffer) != 0)
+        {
+            std::cerr << "Input file " << inputs[f] << " does not exist." << std::endl;
+            return false;
+        }
+
+        PutU32(out, inputs[f].size());
+        out += inputs[f];
+        PutU64(out, buffer.st_size);
+        PutU64(out, buffer.st_mtime);
+    }
+
+    foreach_rigids(r_it, rigids)
+    {
+        EncodeFragment(out, **r_it);
+    }
+
+    foreach_linkers(l_it, linkers)
+    {
+        EncodeFragment(out, **l_it);
+    }
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (file == 0)
+    {
+        std::cerr << "Library file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+    written = fclose(file) == 0 && written;
+
+    if (!written) std::cerr << "Write to " << fileName << " failed." << std::endl;
+
+    return written;
+}
+
+// ****************************************************************************
+
+bool FragmentLibrary::ReadInputs(Input& in, std::vector<std::string>& names,
+                                 std::vector<unsigned long long>& sizes,
+                                 std::vector<unsigned long long>& mtimes)
+{
+    const unsigned char* magic = in.take(sizeof(LIBRARY_MAGIC));
+    if (magic == 0 || memcmp(magic, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC)) != 0) return false;
+    if (in.u32() != LIBRARY_VERSION) return false;
+
+    in.u32();
+    in.u32();
+
+    for (unsigned f = in.u32(); f > 0 && in.ok; f--)
+    {
+        unsigned length = in.u32();
+        const unsigned char* name = in.take(length);
+        if (name == 0) return false;
+
+        names.push_back(std::string((const char*)name, length));
+        sizes.push_back(in.u64());
+        mtimes.push_back(in.u64());
+    }
+
+    return in.ok;
+}
+
+//
+// Map the whole library; the caller unmaps it.
+//
+static const unsigned char* MapLibrary(const std::string& fileName, unsigned long long& size,
+                                       time_t& mtime)
+{
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat buffer;
+    if (fstat(fd, &buffer) != 0 || buffer.st_size == 0)
+    {
+        ::close(fd);
+        return 0;
+    }
+
+    size = buffer.st_size;
+    mtime = buffer.st_mtime;
+
+    void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) return 0;
+
+    return static_cast<const unsigned char*>(mapped);
+}
+
+bool FragmentLibrary::IsCurrent(const std::string& fileName,
+                                const std::vector<std::string>& inputs)
+{
+    unsigned long long size;
+    time_t mtime;
+    const unsigned char* data = MapLibrary(fileName, size, mtime);
+    if (data == 0) return false;
+
+    Input in(data, data + size);
+    std::vector<std::string> names;
+    std::vector<unsigned long long> sizes;
+    std::vector<unsigned long long> mtimes;
+
+    bool current = ReadInputs(in, names, sizes, mtimes);
+
+    munmap(const_cast<unsigned char*>(data), size);
+
+    if (!current) return false;
+
+    if (!inputs.empty() && inputs != names) return false;
+
+    for (unsigned f = 0; f < names.size(); f++)
+    {
+        struct stat buffer;
+        if (stat(names[f].c_str(), &buffer) != 0) continue;
+
+        if ((unsigned long long)buffer.st_size != sizes[f] ||
+            (unsigned long long)buffer.st_mtime != mtimes[f] ||
+            buffer.st_mtime > mtime)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FragmentLibrary::Read(const std::string& fileName,
+                           std::vector<Rigid*>& rigids,
+                           std::vector<Linker*>& linkers)
+{
+    unsigned long long size;
+    time_t mtime;
+    const unsigned char* data = MapLibrary(fileName, size, mtime);
+    if (data == 0)
+    {
+        std::cerr << "Library file " << fileName << " could not be read." << std::endl;
+        return false;
+    }
+
+    Input in(data, data + size);
+    std::vector<std::string> names;
+    std::vector<unsigned long long> sizes;
+    std::vector<unsigned long long> mtimes;
+
+    bool ok = ReadInputs(in, names, sizes, mtimes);
+
+    // The counts are in the header, ahead of the inputs.
+    unsigned numRigids = ok ? GetU32(data + 12) : 0;
+    unsigned numLinkers = ok ? GetU32(data + 16) : 0;
+
+    for (unsigned r = 0; r < numRigids && ok; r++)
+    {
+        Rigid* rigid = new Rigid();
+        ok = DecodeFragment(in, *rigid);
+        rigids.push_back(rigid);
+    }
+
+    for (unsigned ell = 0; ell < numLinkers && ok; ell++)
+    {
+        Linker* linker = new Linker();
+        ok = DecodeFragment(in, *linker);
+        linkers.push_back(linker);
+    }
+
+    munmap(const_cast<unsigned char*>(data), size);
+
+    if (!ok) std::cerr << "Library file " << fileName << " is corrupt." << std::endl;
+
+    return ok;
+}
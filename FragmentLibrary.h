@@ -0,0 +1,92 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAGMENT_LIBRARY_GUARD
+#define _FRAGMENT_LIBRARY_GUARD 1
+
+
+#include <string>
+#include <vector>
+
+
+#include "AtomT.h"
+
+
+class Molecule;
+class Rigid;
+class Linker;
+
+
+//
+// A precompiled fragment library (.lib): the rigids and linkers parsed from
+// SDF files, stored so that synthesis can start without OpenBabel.
+//
+//    Header    : magic[8] "ESYNLIB1", version u32, rigids u32, linkers u32,
+//                input files u32
+//    Inputs    : per SDF file, name (u32 length, bytes), size u64, mtime u64
+//    Fragments : rigids then linkers, in load order:
+//                  atoms u32, bonds u32, MolWt / HBD / HBA1 / logP f64,
+//                  per atom: kind u8 (simple, linker, rigid), type,
+//                    hydrogens u8, heavy neighbors u8,
+//                    connectable: max connections u8, connection id u32,
+//                      rigid: allowed types u8, then each type
+//                  per bond: origin u16, target u16, order u8,
+//                  coordinates u32 (0 or atoms), then x / y / z f64 per atom
+//
+// An atom type is element u8, number i16, special u8. All integers are
+// little-endian; the file is memory-mapped and read front to back.
+//
+class FragmentLibrary
+{
+  public:
+    // Write the fragments loaded from the given input files.
+    static bool Write(const std::string& fileName,
+                      const std::vector<std::string>& inputs,
+                      const std::vector<Rigid*>& rigids,
+                      const std::vector<Linker*>& linkers);
+
+    // Restore the fragments; false (with a message) if the file is invalid.
+    static bool Read(const std::string& fileName,
+                     std::vector<Rigid*>& rigids,
+                     std::vector<Linker*>& linkers);
+
+    //
+    // A library is current if it was compiled from the given inputs (when any
+    // are given) and every input it records is unchanged and not newer than it.
+    //
+    static bool IsCurrent(const std::string& fileName,
+                          const std::vector<std::string>& inputs);
+
+    static const char* const SUFFIX;
+
+  private:
+    // Bounds-checked reading of the mapped file
+    struct Input;
+
+    static void EncodeFragment(std::string& out, const Molecule& fragment);
+    static bool DecodeFragment(Input& in, Molecule& fragment);
+
+    static void EncodeAtomType(std::string& out, const AtomT& type);
+    static AtomT DecodeAtomType(Input& in);
+
+    // The recorded input files
+    static bool ReadInputs(Input& in, std::vector<std::string>& names,
+                           std::vector<unsigned long long>& sizes,
+                           std::vector<unsigned long long>& mtimes);
+};
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <pthread.h>
+
+
+#include <openbabel/obconversion.h>
+#include <openbabel/mol.h>
+#include <openbabel/descriptor.h>
+
+
+#include "FragmentLoader.h"
+#include "Molecule.h"
+#include "Rigid.h"
+#include "Linker.h"
+#include "SdfScanner.h"
+#include "Options.h"
+#include "Constants.h"
+
+
+static Molecule* createLocalMolecule(OpenBabel::OBMol* mol, MoleculeT mType,
+                                     const std::string& name, const SdfRecord& record)
+{
+    //
+    // Create this particular molecule type based on the name of the file; the
+    // appendix (our data) is parsed directly from the record.
+    //
+    if (mType == LINKER)
+    {
+        return new Linker(mol, name, record);
+    }
+    else if (mType == RIGID)
+    {
+        return new Rigid(mol, name, record);
+    }
+    
+    return 0;
+}
+
+//
+// The fragments of one input file; files are loaded independently and merged in order.
+//
+struct FragmentFile
+{
+    std::string fileName;
+    std::vector<Molecule*> molecules;
+
+    // Descriptor log entries for this file
+    std::string log;
+};
+
+static void readMoleculeFile(FragmentFile& file)
+{
+    const char* fileName = file.fileName.c_str();
+
+    //
+    // Input parser conversion functionality for Open babel; one per file (thread).
+    //
+    pthread_mutex_lock(&Molecule::openbabel_lock);
+
+    OpenBabel::OBConversion obConversion;
+    obConversion.SetInFormat("SDF");
+
+    pthread_mutex_unlock(&Molecule::openbabel_lock);
+
+    //
+    // Map the file; each record is split into Molecule Data (molblock) and
+    // Our Data (appendix) without copying.
+    //
+    SdfScanner scanner;
+    if (!scanner.open(fileName)) return;
+
+    std::ostringstream logfile;
+
+    SdfRecord record;
+    while (scanner.next(record))
+    {
+        //
+        // If the name of molecule is not given, overwrite it with the name of the file.
+        //
+        std::string name;
+        if (record.name.empty())
+        {
+           name = "####   ";
+           name += fileName;
+           name += "    ####";
+        }
+        else name = record.name.str();
+
+        if (g_debug_output) std::cerr << "Name: " << std::endl << name << std::endl;
+        if (g_debug_output) std::cerr << "Prefix: " << std::endl << record.molblock.str() << std::endl;
+        if (g_debug_output) std::cerr << "Suffix: " << std::endl << record.appendix.str() << std::endl;
+
+        //
+        // Create and parse using Open Babel (which requires its own copy of the molblock).
+        // Open Babel is not thread-safe, so the parse holds the global lock, as does
+        // the molecule constructor while it reads the OBMol: the threads parse one
+        // molecule at a time, and only scanning, our appendix and logging overlap.
+        //
+        std::string molblock = record.molblock.str();
+
+        pthread_mutex_lock(&Molecule::openbabel_lock);
+
+        OpenBabel::OBMol* mol = new OpenBabel::OBMol();
+        obConversion.ReadString(mol, molblock);
+
+        pthread_mutex_unlock(&Molecule::openbabel_lock);
+
+        // Assign all needed data to the molecule
+        Molecule* local = createLocalMolecule(mol, fileName[0] == 'l' ? LINKER : RIGID,
+                                              name, record);
+
+//std::cerr << *local << std::endl;
+
+        // add to logfile; the descriptors were computed when the molecule was created.
+        if (local->isLipinskiCompliant())
+        {
+            logfile << fileName << "\nMolWt = " << local->getMolWt() << "\n";
+            logfile << "HBD = " << local->getHBD() << "\n";
+            logfile << "HBA1 = " << local->getHBA1() << "\n";
+            logfile << "logP = " << local->getlogP() << "\n";
+            logfile << "\n";
+        }
+        else std::cerr << "Main: predictLipinski failed somehow!" << std::endl;
+
+        if (g_debug_output) std::cout << "Local: " << *local << "|" << std::endl;
+    
+        file.molecules.push_back(local);
+
+        // We don't keep a copy of the OpenBabel molecule anymore.
+        pthread_mutex_lock(&Molecule::openbabel_lock);
+        delete mol;
+        pthread_mutex_unlock(&Molecule::openbabel_lock);
+    }
+
+    file.log = logfile.str();
+}
+
+//
+// Loader threads claim input files in turn.
+//
+struct LoaderArgs
+{
+    std::vector<FragmentFile>* files;
+    volatile unsigned next;
+};
+
+static void* LoaderThread(void* args_void)
+{
+    LoaderArgs* args = static_cast<LoaderArgs*>(args_void);
+
+    unsigned f;
+    while ((f = __sync_fetch_and_add(&args->next, 1)) < args->files->size())
+    {
+        readMoleculeFile((*args->files)[f]);
+    }
+
+    return 0;
+}
+
+bool LoadFragmentFiles(const std::vector<std::string>& fileNames,
+                       std::vector<Rigid*>& rigids,
+                       std::vector<Linker*>& linkers)
+{
+    std::vector<FragmentFile> files(fileNames.size());
+
+    for (unsigned f = 0; f < fileNames.size(); f++)
+    {
+        const std::string& fileName = fileNames[f];
+
+        if (fileName[0] != 'l' && fileName[0] != 'r')
+        {
+            std::cerr << "Unexpected file prefix: \'" << fileName[0]
+                 << "\' with file " << fileName << std::endl;
+            return false;
+        }
+
+        files[f].fileName = fileName;
+    }
+
+    //
+    // Share the files among threads (Open Babel parsing remains serialized)
+    //
+    unsigned numThreads = Options::LOAD_THREADS;
+    if (numThreads == 0) numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads > files.size()) numThreads = files.size();
+    if (numThreads == 0) numThreads = 1;
+
+    // Register the OpenBabel formats and descriptors before any thread uses them.
+    {
+        OpenBabel::OBConversion obConversion;
+        obConversion.SetInFormat("SDF");
+        OpenBabel::OBDescriptor::FindType("HBD");
+    }
+
+    LoaderArgs args;
+    args.files = &files;
+    args.next = 0;
+
+    std::vector<pthread_t> threads(numThreads - 1);
+    unsigned started = 0;
+    for ( ; started < threads.size(); started++)
+    {
+        if (pthread_create(&threads[started], NULL, LoaderThread, &args) != 0) break;
+    }
+
+    // This thread loads as well.
+    LoaderThread(&args);
+
+    for (unsigned t = 0; t < started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    //
+    // Merge in input order; base molecule ids are assigned by position.
+    //
+    std::string log;
+    for (unsigned f = 0; f < files.size(); f++)
+    {
+        for (unsigned m = 0; m < files[f].molecules.size(); m++)
+        {
+            if (files[f].fileName[0] == 'l')
+            {
+                linkers.push_back(static_cast<Linker*>(files[f].molecules[m]));
+            }
+            else rigids.push_back(static_cast<Rigid*>(files[f].molecules[m]));
+        }
+
+        log += files[f].log;
+    }
+
+    std::ofstream logfile("synth_log_initial_fragments_logfile.txt",
+                          std::ofstream::out | std::ofstream::app); // append
+    logfile << log;
+    logfile.close();
+
+    return true;
+}
@@ -0,0 +1,44 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAGMENT_LOADER_GUARD
+#define _FRAGMENT_LOADER_GUARD 1
+
+
+#include <string>
+#include <vector>
+
+
+#include "Rigid.h"
+#include "Linker.h"
+
+
+//
+// Parse the rigid ('r' prefix) and linker ('l' prefix) SDF files; the fragments
+// are appended in the order the files are given.
+//
+// The files are shared among Options::LOAD_THREADS threads, but every Open Babel
+// step (the parse, the descriptors, freeing the OBMol) holds Molecule::openbabel_lock,
+// so molecules are parsed one at a time. Only mapping and scanning the files,
+// parsing our appendix, and the descriptor log overlap. To start quickly, load
+// a precompiled fragment library (-lib) instead.
+//
+bool LoadFragmentFiles(const std::vector<std::string>& fileNames,
+                       std::vector<Rigid*>& rigids,
+                       std::vector<Linker*>& linkers);
+
+#endif
@@ -23,6 +23,8 @@
 #include <pthread.h>
 #include <map>
 #include <algorithm>
+#include <sstream>
+#include <cstdlib>
 
 
 #include "Molecule.h"
@@ -42,10 +44,16 @@
 #include "OBWriter.h"
 #include "Options.h"
 #include "bloom_filter.hpp"
+#include "Checkpoint.h"
+#include "BlockReader.h"
+#include "QueueController.h"
+#include "SpillingQueue.h"
 
 
 
 // 0 indicates we let the queue size be limitless.
+// In threaded mode, pushing into a full level queue blocks the producing level.
+// These are the defaults; with a memory budget (-mem-budget) they are scaled (QueueController).
 const unsigned Instantiator::MAX_QUEUE_SIZES[22] = { 0,   // Level 0
                                                      0,   //       1
                                                      300, //       2
@@ -70,6 +78,9 @@ const unsigned Instantiator::MAX_QUEUE_SIZES[22] = { 0,   // Level 0
                                                      1    //       21
                                                    };
 
+// Spilling level queues (-spill) are limitless; each level is completed before the next.
+static const unsigned NO_QUEUE_LIMITS[22] = { 0 };
+
 // The anticipated sizes of the level (at max). 0 indicates we are not using a Bloom filter.
 const unsigned long long Instantiator::LEVEL_SIZES[22] = { 0,       // Level 0
                                                            0,       //       1
@@ -99,51 +110,75 @@ const unsigned long long Instantiator::LEVEL_SIZES[22] = { 0,       // Level 0
 
 Instantiator::Instantiator(OBWriter*const obWriter, std::ostream& out) : writer(obWriter),
                                                                          ds(out),
-                                                                         excluded(0),
-                                                                         overallMoleculeCount(0)
+                                                                         stats(HIERARCHICAL_LEVEL_BOUND + 1),
+                                                                         exclusionRng(Options::SEED),
+                                                                         queueController(Options::SPILL_DIR == "" ?
+                                                                                         MAX_QUEUE_SIZES : NO_QUEUE_LIMITS,
+                                                                                         HIERARCHICAL_LEVEL_BOUND + 1,
+                                                                                         Options::MEMORY_BUDGET),
+                                                                         targets(0),
+                                                                         stopping(false)
 {
     graph = new MoleculeHashHypergraph(HIERARCHICAL_LEVEL_BOUND + 1);
 
     // The hypergraph lock
     pthread_mutex_init(&graph_lock, NULL);
 
-    // The threads and locks for the producer-consumer containers.
-    level_queues = new std::queue<Molecule*>[HIERARCHICAL_LEVEL_BOUND + 1];
-    moleculeLevelCount = new int[HIERARCHICAL_LEVEL_BOUND + 1];
+    // The producer-consumer containers; limitless until capacities are applied.
+    level_queues = new SpillingQueue[HIERARCHICAL_LEVEL_BOUND + 1];
+
+    //
+    // Beyond the threshold, queued molecules are kept on disk as their assemblies.
+    //
+    if (Options::SPILL_DIR != "")
+    {
+        MakeDirectory(Options::SPILL_DIR);
+
+        for (int m = 2; m <= HIERARCHICAL_LEVEL_BOUND; m++)
+        {
+            std::ostringstream prefix;
+            prefix << Options::SPILL_DIR << "/level-" << m;
+
+            level_queues[m].enable_spill(prefix.str(), Options::SPILL_THRESHOLD);
+        }
+    }
 
     // Create the bloom filters
 
     if (Options::THREADED)
     {
-        queue_locks = new pthread_mutex_t[HIERARCHICAL_LEVEL_BOUND + 1]; 
         queue_threads = new pthread_t[HIERARCHICAL_LEVEL_BOUND + 1];
-        completed_level = new bool[HIERARCHICAL_LEVEL_BOUND + 1];
         arg_pointer = new Instantiator_ProcessLevel_Thread_Args[HIERARCHICAL_LEVEL_BOUND + 1];
     }
     for (int m = 1; m <= HIERARCHICAL_LEVEL_BOUND; m++)
     {
         if (Options::THREADED)
         {
-            // Initialize those container locks.
-            pthread_mutex_init(&queue_locks[m], NULL);
-    
-            // Initialize the fact that we have not computed this level. 
-            completed_level[m] = false;
-
             // set up arg structs
             arg_pointer[m].m = m;
             arg_pointer[m].graph = graph;
             arg_pointer[m].this_pointer = this;
         }
-
-        // We have create 0 molecules at this level, thus far.
-        moleculeLevelCount[m] = 0;
     }
 
+    if (Options::THREADED) ApplyQueueCapacities();
+
     InitOverallFilter();
     InitLevelFilters();
 }
 
+//
+// Threaded: level 2 is completely constructed before any level thread starts;
+// anything over level 13 should fly through.
+//
+void Instantiator::ApplyQueueCapacities()
+{
+    for (int m = 3; m <= HIERARCHICAL_LEVEL_BOUND && m < 13; m++)
+    {
+        level_queues[m].set_capacity(queueController.limit(m));
+    }
+}
+
 //
 // Initialize the Bloom filter among all levels
 //
@@ -175,7 +210,7 @@ void Instantiator::InitOverallFilter()
     parameters.compute_optimal_parameters();
 
     // Create the Bloom filter.
-    overall_filter = new bloom_filter(parameters);
+    overall_filter = new PersistentBloomFilter(parameters);
 }
 
 //
@@ -212,7 +247,7 @@ void Instantiator::InitLevelFilters()
 
             parameters.compute_optimal_parameters();
 
-            filters.push_back(new bloom_filter(parameters));
+            filters.push_back(new PersistentBloomFilter(parameters));
         }
     }
 }
@@ -262,7 +297,7 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
     InitializeSynthesis(linkers, rigids);
 
     // Indicate size of 1-M lists
-    moleculeLevelCount[1] = baseMolecules.size();
+    stats.addProcessed(1, baseMolecules.size());
     
     //
     // One level at a time:
@@ -277,9 +312,9 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
         //if (level == Options::SMI_LEVEL_BOUND + 1) writer->IndicateSMIwritingComplete();
         
         // Track the number of molecules at this level
-        moleculeLevelCount[level] = level_queues[level].size();
+        unsigned levelSize = level_queues[level].size();
 
-        std::cerr << "Level " << level << " has " << moleculeLevelCount[level]
+        std::cerr << "Level " << level << " has " << levelSize
                   << " molecules to process." << std::endl; 
 
         int counter = 1;
@@ -292,7 +327,7 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
             if (++counter % 500 == 0)
             {
                 std::cerr << "Processing molecule " << counter
-                          << " of " << moleculeLevelCount[level]
+                          << " of " << levelSize
                           << " at level " << level << std::endl;
             }
 
@@ -314,7 +349,7 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
     std::cout << "Level\t" << "# Molecules" << std::endl;
     for (int m = 1; m <= HIERARCHICAL_LEVEL_BOUND; m++)
     {
-       std::cout << m << "\t" << moleculeLevelCount[m] << std::endl;
+       std::cout << m << "\t" << stats.getProcessed(m) << std::endl;
     }
 
     // Tell the output engine we have completed synthesis.
@@ -332,28 +367,67 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
 MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& linkers,
                                                         std::vector<Rigid*>& rigids)
 {
+    int level = 2;
+    unsigned molsProcessed = 0;
+
+    if (Options::RESUME_DIR != "")
+    {
+        ResumeSynthesis(linkers, rigids, level, molsProcessed);
+    }
+    else
+    {
+        //
+        // Synthesizes level 2 molecules using SMI comparison.
+        //
+        InitializeSynthesis(linkers, rigids);
+
+        // Indicate size of 1-M lists
+        stats.addProcessed(1, baseMolecules.size());
+    }
+
+    if (Options::CHECKPOINT)
+    {
+        Checkpoint::InstallSignalHandlers();
+        nextCheckpoint = time(0) + 60 * Options::CHECKPOINT_MINUTES;
+    }
+
     //
-    // Synthesizes level 2 molecules using SMI comparison.
+    // A resumed run was processing 'level' with each level below it waiting on
+    // the next (SerialInstantiateHelper); completing each level in turn, from
+    // the top, continues exactly as the interrupted run would have.
     //
-    InitializeSynthesis(linkers, rigids);
-
-    // Indicate size of 1-M lists
-    moleculeLevelCount[1] = baseMolecules.size();
+    for ( ; level > 2; level--)
+    {
+        SerialInstantiateHelper(level, molsProcessed);
+    }
 
     //
     // Using the level 2 molecules as a base case, process indicating non-completion.
     //
-    unsigned molsProcessed = 0;
-    while (!level_queues[2].empty())
+    while (!stopping && !level_queues[2].empty())
     {
         SerialInstantiateHelper(2, molsProcessed);
     }
 
+    CompleteSerialSynthesis();
+
+    return graph;
+}
+
+void Instantiator::CompleteSerialSynthesis()
+{
     //
     // Kill all levels
     //
     for (int m = 2; m <= HIERARCHICAL_LEVEL_BOUND; m++)
     {
+        // Molecules left unprocessed when stopping early
+        Molecule* mol = 0;
+        while (level_queues[m].try_pop(mol))
+        {
+            delete mol;
+        }
+
         // Kill this level in the hypergraph
         graph->killLevel(m);
 
@@ -365,16 +439,199 @@ MoleculeHashHypergraph* Instantiator::SerialInstantiate(std::vector<Linker*>& li
     std::cout << "Level\t" << "# Molecules" << std::endl;
     for (int m = 1; m <= HIERARCHICAL_LEVEL_BOUND; m++)
     {
-       std::cout << m << "\t" << moleculeLevelCount[m] << std::endl;
+       std::cout << m << "\t" << stats.getProcessed(m) << std::endl;
     }
 
     // Tell the output engine we have completed synthesis.
     // This function then spins until the thread pool is complete.
     this->writer->IndicateSynthesisComplete();
+}
+
+//
+// A molecule containing an added fragment is either
+//    (a) a previous molecule (or fragment) composed with an added fragment, or
+//    (b) a smaller molecule containing an added fragment composed with any fragment
+// (remove a leaf fragment: a previous one, or an added one when another remains).
+// The previous run output (a); the level queues, as in serial synthesis, provide (b).
+// Previous molecules are only read, so the work follows the added molecules.
+//
+MoleculeHashHypergraph* Instantiator::IncrementalInstantiate(std::vector<Linker*>& linkers,
+                                                             std::vector<Rigid*>& rigids,
+                                                             unsigned numPreviousRigids,
+                                                             unsigned numPreviousLinkers)
+{
+    InitializeBaseMolecules(rigids, linkers, baseMolecules);
+
+    //
+    // Base ids are positional (rigids, then linkers); added rigids shift the previous linkers.
+    //
+    std::vector<unsigned> previousIds;
+    std::vector<Molecule*> previous;
+    std::vector<Molecule*> added;
+    std::vector<bool> isAdded(baseMolecules.size(), true);
+
+    for (unsigned r = 0; r < rigids.size(); r++)
+    {
+        if (r < numPreviousRigids) previousIds.push_back(r);
+        else added.push_back(baseMolecules[r]);
+    }
+
+    for (unsigned ell = 0; ell < linkers.size(); ell++)
+    {
+        unsigned id = rigids.size() + ell;
+
+        if (ell < numPreviousLinkers) previousIds.push_back(id);
+        else added.push_back(baseMolecules[id]);
+    }
+
+    for (unsigned p = 0; p < previousIds.size(); p++)
+    {
+        previous.push_back(baseMolecules[previousIds[p]]);
+        isAdded[previousIds[p]] = false;
+    }
+
+    std::vector<std::string> files;
+    ListDirectory(Options::EXTEND_DIR, std::string(".asm") + BlockFormat::SUFFIX, files);
+
+    if (files.empty())
+    {
+        std::cerr << "No binary output (-binary) found in " << Options::EXTEND_DIR
+                  << "; exiting." << std::endl;
+        exit(1);
+    }
+
+    this->writer->IndicateSynthesisStarted();
+
+    foreach_molecules(m_it, baseMolecules)
+    {
+        graph->addNode((*m_it)->ConstructMinimalMolecule(), 1);
+    }
+
+    stats.addProcessed(1, added.size());
+
+    //
+    // Level 2: each pair with an added fragment.
+    //
+    for (int m1 = 0; m1 < baseMolecules.size(); m1++)
+    {
+        for (int m2 = m1; m2 < baseMolecules.size(); m2++)
+        {
+            if (!isAdded[m1] && !isAdded[m2]) continue;
+
+            std::vector<EdgeAggregator*>* newEdges =
+                                          baseMolecules[m1]->Compose(*baseMolecules[m2]);
+
+            HandleNewMolecules(level_queues[2], filters[2], newEdges);
+        }
+    }
+
+    unsigned molsProcessed = 0;
+    unsigned previousLibrary = Molecule::LibraryHash(previous);
+
+    for (unsigned f = 0; f < files.size() && !stopping; f++)
+    {
+        if (!ExtendPreviousOutput(files[f], previousLibrary, previousIds, added, molsProcessed))
+        {
+            exit(1);
+        }
+    }
+
+    //
+    // Complete each level, lowest first; processing a level completes those above it.
+    //
+    for (int level = 2; level < HIERARCHICAL_LEVEL_BOUND; level++)
+    {
+        while (!stopping && !level_queues[level].empty())
+        {
+            SerialInstantiateHelper(level, molsProcessed);
+        }
+    }
+
+    CompleteSerialSynthesis();
 
     return graph;
 }
 
+//
+// Previous assemblies are renumbered to the current base ids, reassembled, and
+// composed with each added fragment; those at the level bound are skipped.
+//
+bool Instantiator::ExtendPreviousOutput(const std::string& fileName,
+                                        unsigned previousLibrary,
+                                        const std::vector<unsigned>& previousIds,
+                                        const std::vector<Molecule*>& added,
+                                        unsigned& processedMols)
+{
+    BlockReader reader;
+    if (!reader.open(fileName)) return false;
+
+    if (reader.getEncoding() != BlockFormat::ENCODING_ASSEMBLY ||
+        reader.getLibrary() != previousLibrary)
+    {
+        std::cerr << fileName << " was not synthesized from the fragments given"
+                  << " (less those added)." << std::endl;
+        return false;
+    }
+
+    std::cerr << "Extending the molecules of " << fileName << std::endl;
+
+    for (unsigned b = 0; b < reader.numBlocks() && !stopping; b++)
+    {
+        if (reader.block(b).minLevel >= HIERARCHICAL_LEVEL_BOUND) continue;
+
+        std::vector<std::string> records;
+        if (!reader.readBlock(b, records)) return false;
+
+        for (unsigned r = 0; r < records.size() && !stopping; r++)
+        {
+            //
+            // Renumber the fragments: the first value, then the middle of each (atom, fragment, atom).
+            //
+            const unsigned char* in = (const unsigned char*)records[r].data();
+            const unsigned char* end = in + records[r].size();
+
+            std::string assembly;
+            unsigned value;
+            unsigned v = 0;
+            for ( ; in < end; v++)
+            {
+                if (!GetVarint(in, end, value) ||
+                    ((v == 0 || v % 3 == 2) && value >= previousIds.size())) break;
+
+                PutVarint(assembly, v == 0 || v % 3 == 2 ? previousIds[value] : value);
+            }
+
+            int level = 1 + v / 3;
+            if (level >= HIERARCHICAL_LEVEL_BOUND) continue;
+
+            Molecule* mol = in == end && v % 3 == 1 ? Molecule::Reassemble(assembly) : 0;
+            if (mol == 0)
+            {
+                std::cerr << "Molecule " << reader.block(b).firstId + r << " of " << fileName
+                          << " has an invalid assembly." << std::endl;
+                return false;
+            }
+
+            for (unsigned a = 0; a < added.size(); a++)
+            {
+                std::vector<EdgeAggregator*>* newEdges = mol->Compose(*added[a]);
+
+                HandleNewMolecules(level_queues[level + 1], filters[level + 1], newEdges);
+            }
+
+            delete mol;
+
+            // Adhere to the capacity of the next level; process it (and those above) when full.
+            if (!queueController.admits(level + 1, level_queues[level + 1].size()))
+            {
+                SerialInstantiateHelper(level + 1, processedMols);
+            }
+        }
+    }
+
+    return true;
+}
+
 //
 // Given the current level, generate molecules in (level + 1) up to the capacity specified.
 // When the capacity is exceeded, call this function recursively to process (level + 1)
@@ -390,10 +647,9 @@ void Instantiator::SerialInstantiateHelper(int level, unsigned& processedMols)
     if (level >= HIERARCHICAL_LEVEL_BOUND)
     {
         // Kill the contents of the queue
-        while (!level_queues[level].empty())
+        Molecule* currentMol = 0;
+        while (level_queues[level].try_pop(currentMol))
         {
-            Molecule* currentMol = level_queues[level].front();
-            level_queues[level].pop();
             delete currentMol;
         }
 
@@ -404,24 +660,28 @@ void Instantiator::SerialInstantiateHelper(int level, unsigned& processedMols)
     //
     // Completely process all molecules in this level into level + 1
     //
-    while (!level_queues[level].empty())
+    while (!stopping && !level_queues[level].empty())
     {
         //
         // Adhere to capacities specified for each level
         //
-        while (MAX_QUEUE_SIZES[level + 1] == 0 || level_queues[level + 1].size() < MAX_QUEUE_SIZES[level + 1])
+        while (!stopping && queueController.admits(level + 1, level_queues[level + 1].size()))
         {
+            // This level's queue is not empty here; a resumed run restarts at this point.
+            if (Options::CHECKPOINT && CheckpointDue()) WriteCheckpoint(level, processedMols);
+
             //
             // Take a molecule from this level queue.
             //
-            Molecule* currentMol = level_queues[level].front();
-            level_queues[level].pop();
+            Molecule* currentMol = 0;
+            if (!level_queues[level].try_pop(currentMol)) break;
 
-            moleculeLevelCount[level]++;
+            stats.processed(level);
+            unsigned long long levelCount = stats.getProcessed(level);
 
             if (++processedMols % 1000 == 0 || level <= 6)
             {
-                std::cerr << "Processing molecule " << moleculeLevelCount[level]
+                std::cerr << "Processing molecule " << levelCount
                           << " at level " << level
                           << " queue contains (" << level_queues[level].size()
                           << "); Overall Processed Count: " 
@@ -434,7 +694,7 @@ void Instantiator::SerialInstantiateHelper(int level, unsigned& processedMols)
                 std::cerr << "Level\t" << "# Molecules" << std::endl;
                 for (int m = 2; m <= HIERARCHICAL_LEVEL_BOUND; m++)
                 {
-                    std::cerr << m << "\t" << moleculeLevelCount[m] << std::endl;
+                    std::cerr << m << "\t" << stats.getProcessed(m) << std::endl;
                 }
             }
 
@@ -456,16 +716,232 @@ void Instantiator::SerialInstantiateHelper(int level, unsigned& processedMols)
 }
 
 
+//
+// The fragments and options that determine the molecules and their output;
+// a checkpoint only resumes a run with the same settings.
+//
+static std::string RunSettings(const TargetSet* targets)
+{
+    std::ostringstream oss;
+
+    oss << "library " << Molecule::LibraryHash()
+        << " levels " << HIERARCHICAL_LEVEL_BOUND
+        << " prune " << Options::PROBABILITY_PRUNE_LEVEL_START
+        << " seed " << Options::SEED
+        << " lipinski " << Options::USE_LIPINSKI
+        << " directed " << Options::TARGET_DIRECTED
+        << " binary " << Options::BINARY_OUTPUT
+        << " props " << Options::PROPERTY_SIDECAR
+        << " block " << Options::BLOCK_RECORDS
+        << " gzip " << (Options::COMPRESSION_THREADS > 0)
+        << " targets " << (targets != 0 ? targets->hash() : 0);
+
+    return oss.str();
+}
+
+bool Instantiator::CheckpointDue() const
+{
+    if (Checkpoint::Requested()) return true;
+
+    return Options::CHECKPOINT_MINUTES > 0 && time(0) >= nextCheckpoint;
+}
+
+void Instantiator::WriteCheckpoint(int level, unsigned processedMols)
+{
+    Checkpoint::ClearRequest();
+    nextCheckpoint = time(0) + 60 * Options::CHECKPOINT_MINUTES;
+
+    // The output position: every molecule synthesized so far has been written.
+    unsigned long long outputCount = 0;
+    std::string journal;
+    if (!writer->SyncOutput(outputCount, journal))
+    {
+        std::cerr << "Output could not be synchronized; no checkpoint written." << std::endl;
+        return;
+    }
+
+    Checkpoint checkpoint;
+    if (!checkpoint.create(writer->getOutputDir())) return;
+
+    checkpoint.putBytes(RunSettings(targets));
+    checkpoint.putU32(level);
+    checkpoint.putU32(processedMols);
+    checkpoint.putU64(outputCount);
+    checkpoint.putBytes(journal);
+
+    SynthesisStatistics::Snapshot snapshot = stats.snapshot();
+    for (unsigned c = 0; c < SynthesisStatistics::NUM_COUNTERS; c++)
+    {
+        checkpoint.putU64(snapshot.counters[c]);
+    }
+
+    checkpoint.putU32(snapshot.processed.size());
+    for (unsigned m = 0; m < snapshot.processed.size(); m++)
+    {
+        checkpoint.putU64(snapshot.processed[m]);
+    }
+
+    //
+    // Queued molecules, in order, as their assemblies; each is put back in turn.
+    //
+    for (int m = 0; m <= HIERARCHICAL_LEVEL_BOUND; m++)
+    {
+        unsigned count = level_queues[m].size();
+        checkpoint.putU32(count);
+
+        for (unsigned q = 0; q < count; q++)
+        {
+            Molecule* mol = 0;
+            level_queues[m].try_pop(mol);
+
+            checkpoint.putBytes(mol->getAssembly());
+
+            level_queues[m].push(mol);
+        }
+    }
+
+    checkpoint.putFilter(*overall_filter);
+
+    checkpoint.putU32(filters.size());
+    for (unsigned m = 0; m < filters.size(); m++)
+    {
+        checkpoint.putU32(filters[m] != 0);
+        if (filters[m] != 0) checkpoint.putFilter(*filters[m]);
+    }
+
+    // The targets found so far; none without -targets.
+    if (targets != 0) targets->write(checkpoint);
+    else checkpoint.putU32(0);
+
+    if (checkpoint.commit())
+    {
+        std::cerr << "Checkpoint written at level " << level << " after "
+                  << outputCount << " molecules." << std::endl;
+    }
+
+    if (Checkpoint::StopRequested())
+    {
+        std::cerr << "Stopping; continue with -resume " << writer->getOutputDir() << std::endl;
+        exit(0);
+    }
+}
+
+bool Instantiator::RestoreCheckpoint(int& level, unsigned& processedMols)
+{
+    Checkpoint checkpoint;
+    if (!checkpoint.open(Options::RESUME_DIR)) return false;
+
+    std::string settings;
+    checkpoint.getBytes(settings);
+    if (settings != RunSettings(targets))
+    {
+        std::cerr << "The checkpoint was written with other fragments or options:" << std::endl
+                  << "\t" << settings << std::endl
+                  << "rather than" << std::endl
+                  << "\t" << RunSettings(targets) << std::endl;
+        return false;
+    }
+
+    level = checkpoint.getU32();
+    processedMols = checkpoint.getU32();
+
+    unsigned long long outputCount = checkpoint.getU64();
+    std::string journal;
+    checkpoint.getBytes(journal);
+
+    for (unsigned c = 0; c < SynthesisStatistics::NUM_COUNTERS; c++)
+    {
+        stats.add((SynthesisStatistics::Counter)c, checkpoint.getU64());
+    }
+
+    unsigned numLevels = checkpoint.getU32();
+    for (unsigned m = 0; m < numLevels && checkpoint.ok(); m++)
+    {
+        stats.addProcessed(m, checkpoint.getU64());
+    }
+
+    for (int m = 0; m <= HIERARCHICAL_LEVEL_BOUND && checkpoint.ok(); m++)
+    {
+        unsigned count = checkpoint.getU32();
+
+        for (unsigned q = 0; q < count && checkpoint.ok(); q++)
+        {
+            std::string assembly;
+            checkpoint.getBytes(assembly);
+
+            Molecule* mol = Molecule::Reassemble(assembly);
+            if (mol == 0)
+            {
+                std::cerr << "A queued molecule could not be reassembled." << std::endl;
+                return false;
+            }
+
+            level_queues[m].push(mol);
+        }
+    }
+
+    checkpoint.getFilter(*overall_filter);
+
+    unsigned numFilters = checkpoint.getU32();
+    for (unsigned m = 0; m < numFilters && m < filters.size() && checkpoint.ok(); m++)
+    {
+        bool present = checkpoint.getU32() != 0;
+        if (present != (filters[m] != 0)) return false;
+
+        if (present) checkpoint.getFilter(*filters[m]);
+    }
+
+    bool targetsRestored = targets != 0 ? targets->read(checkpoint) : checkpoint.getU32() == 0;
+
+    if (!checkpoint.ok() || numFilters != filters.size() || !targetsRestored || level < 2)
+    {
+        std::cerr << "The checkpoint in " << Options::RESUME_DIR << " is corrupt." << std::endl;
+        return false;
+    }
+
+    writer->ResumeOutput(outputCount, journal);
+
+    // A run checkpointed as its last target was found has nothing left to do.
+    if (targets != 0 && targets->complete()) stopping = true;
+
+    return true;
+}
+
+//
+// Initialize the fragments, then the state of the checkpointed run in place of level 2.
+//
+void Instantiator::ResumeSynthesis(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids,
+                                   int& level, unsigned& processedMols)
+{
+    InitializeBaseMolecules(rigids, linkers, baseMolecules);
+
+    if (!RestoreCheckpoint(level, processedMols))
+    {
+        std::cerr << "Resuming from " << Options::RESUME_DIR << " failed; exiting." << std::endl;
+        exit(1);
+    }
+
+    this->writer->IndicateSynthesisStarted();
+
+    foreach_molecules(m_it, baseMolecules)
+    {
+        graph->addNode((*m_it)->ConstructMinimalMolecule(), 1);
+    }
+
+    std::cerr << "Resuming at level " << level << std::endl;
+}
+
 //
 // Creates the 2-molecules and initializes the fragments.
 //
 void Instantiator::InitializeSynthesis(std::vector<Linker*>& linkers,
                                        std::vector<Rigid*>& rigids)
 {
-    this->writer->IndicateSynthesisStarted();
-
+    // Base molecules first: binary output records the fragment library.
     InitializeBaseMolecules(rigids, linkers, baseMolecules);
 
+    this->writer->IndicateSynthesisStarted();
+
     // Add  all the base molecules to the hypergraph
     foreach_molecules(m_it, baseMolecules)
     {
@@ -482,13 +958,26 @@ void Instantiator::InitializeSynthesis(std::vector<Linker*>& linkers,
             std::vector<EdgeAggregator*>* newEdges =
                                           baseMolecules[m1]->Compose(*baseMolecules[m2]);
 
-            HandleNewMolecules(level_queues[2], &queue_locks[2], filters[2], newEdges);
+            HandleNewMolecules(level_queues[2], filters[2], newEdges);
         }
     }
 
     std::cerr << "Done creating level 2" << std::endl;
 }
 
+//
+// The estimated descriptors and fragment counts written to the property sidecar.
+//
+void Instantiator::GetProperties(const Molecule& mol, PropertyRow& row)
+{
+    row.value[PropertyFormat::MOL_WT] = mol.getMolWt();
+    row.value[PropertyFormat::HBD] = mol.getHBD();
+    row.value[PropertyFormat::HBA1] = mol.getHBA1();
+    row.value[PropertyFormat::LOGP] = mol.getlogP();
+    row.value[PropertyFormat::LINKERS] = mol.getNumLinkers();
+    row.value[PropertyFormat::RIGIDS] = mol.getNumRigids();
+}
+
 //
 // Add all new deduced clauses to the worklist if they have not been deduced before.
 // If the given clause has been deduced before, update the hyperedges that were generated
@@ -496,8 +985,7 @@ void Instantiator::InitializeSynthesis(std::vector<Linker*>& linkers,
 //
 // Forward Instantiation does not permit any cycles in the resultant graph.
 //
-void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
-                                      pthread_mutex_t* worklist_lock,
+void Instantiator::HandleNewMolecules(SpillingQueue& worklist,
                                       bloom_filter* const levelFilter,
                                       std::vector<EdgeAggregator*>* newEdges)
 {
@@ -524,23 +1012,30 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
         // Did we generate this molecule previously? Or probability removal?
         bool killMolecule = false;
 
-        // SMI for this molecule
-        std::string smi = (*e_it)->consequent->ConstructSMI();
+        // Target-directed: can this molecule (or any composed from it) become a target?
+        bool unreachable = targets != 0 && targets->isDecomposed() &&
+                           !targets->reachable(*(*e_it)->consequent);
+
+        // SMI for this molecule; not needed if it cannot reach a target.
+        std::string smi = unreachable ? std::string() : (*e_it)->consequent->ConstructSMI();
 
         // Add the consequent node to the graph directly.
         // std::pair<unsigned int, bool> addedResult = AddNode(minMol, level);
 
-        // If we are validating the original molecule, check
-        //if (VALIDATE) Validate();
+        if (unreachable)
+        {
+            killMolecule = true;
 
+            stats.increment(SynthesisStatistics::TARGET_PRUNED);
+        }
         //
         // Check the memory-less dictionary for this level
         //
-        static unsigned prob_excluded = 0;
-        static unsigned overall_filtered = 0;
-        if (levelFilter->contains(smi))
+        else if (levelFilter->contains(smi))
         {
             killMolecule = true;
+
+            stats.increment(SynthesisStatistics::LEVEL_FILTERED);
         }
         //
         // Check the filter that applies to ALL molecules
@@ -549,9 +1044,10 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
         {
             killMolecule = true;
 
-            if (++overall_filtered % 100 == 0)
+            if (stats.increment(SynthesisStatistics::OVERALL_FILTERED) % 100 == 0)
             {
-                std::cerr << "Overall filtered: " << overall_filtered <<  std::endl;
+                std::cerr << "Overall filtered: "
+                          << stats.get(SynthesisStatistics::OVERALL_FILTERED) << std::endl;
             }
         }
         //
@@ -559,14 +1055,17 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
         //
         else if (level >= Options::PROBABILITY_PRUNE_LEVEL_START)
         {
-            if (Molecule::ProbabilisticExclusion((*e_it)->consequent))
+            if (Molecule::ProbabilisticExclusion((*e_it)->consequent, exclusionRng, smi))
             {
                 killMolecule = true;
 
-                if (++prob_excluded % 1000 == 0)
+                if (stats.increment(SynthesisStatistics::PROB_EXCLUDED) % 1000 == 0)
                 {
-                    std::cerr << "Probability excluding molecule: " << prob_excluded
-                          << " (" << 100 * float(prob_excluded) / (overallMoleculeCount + prob_excluded)
+                    unsigned long long excluded = stats.get(SynthesisStatistics::PROB_EXCLUDED);
+                    unsigned long long included = stats.get(SynthesisStatistics::INCLUDED);
+
+                    std::cerr << "Probability excluding molecule: " << excluded
+                          << " (" << 100 * float(excluded) / (included + excluded)
                           << "\%)" << std::endl;
                 }
             }
@@ -585,7 +1084,7 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
         //
         else
         {
-            overallMoleculeCount++;
+            stats.increment(SynthesisStatistics::INCLUDED);
 
             // Add to the level bloom filters
             levelFilter->insert(smi);
@@ -593,12 +1092,47 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
             // Add to the overall bloom filter
             overall_filter->insert(smi);
 
+            // Stop once every target has been synthesized.
+            if (targets != 0 && targets->check(*(*e_it)->consequent, smi, level) &&
+                targets->complete() && !stopping)
+            {
+                std::cerr << "All targets have been synthesized; stopping." << std::endl;
+                stopping = true;
+            }
+
+            // Validation compares known molecules against every included molecule.
+            if (VALIDATE) OBWriter::AddValidationMolecule(*(*e_it)->consequent, smi);
+
             // Validation does not require output
-            if (!VALIDATE) this->writer->OutputMoleculeAppendExternalSMI(smi);
+            if (!VALIDATE)
+            {
+                // Descriptors for the property sidecar
+                PropertyRow row;
+                PropertyRow* properties = 0;
+                if (Options::PROPERTY_SIDECAR)
+                {
+                    GetProperties(*(*e_it)->consequent, row);
+                    properties = &row;
+                }
 
-            if (Options::THREADED) pthread_mutex_lock(worklist_lock);
-            worklist.push((*e_it)->consequent);
-            if (Options::THREADED) pthread_mutex_unlock(worklist_lock);
+                if (Options::BINARY_OUTPUT)
+                {
+                    this->writer->OutputMoleculeAppendAssembly((*e_it)->consequent->getAssembly(),
+                                                               level, properties);
+                }
+                else this->writer->OutputMoleculeAppendExternalSMI(smi, level, properties);
+
+                // 3D output, unless only SMI is requested
+                if (!Options::SMI_ONLY) this->writer->OutputMoleculeConformer(*(*e_it)->consequent);
+            }
+
+            //
+            // Molecules at the level bound are never composed further; there is no
+            // consumer for that queue, so release them now.
+            // Otherwise, this blocks while the next level queue is full.
+            //
+            if (level >= HIERARCHICAL_LEVEL_BOUND) delete (*e_it)->consequent;
+            else worklist.push((*e_it)->consequent);
         }
 
         // Add the actual edge
@@ -612,24 +1146,6 @@ void Instantiator::HandleNewMolecules(std::queue<Molecule*>& worklist,
     delete newEdges;
 }
 
-//
-// On the fly validation of molecules synthesized;
-// Exits if the validation molecule was generated.
-//
-void Instantiator::Validate(const std::string& syn_smi) const
-{
-    // Convert
-    if (syn_smi != validation_smi) return;
-
-    std::cerr << "The give molecule has been synthesized: " << std::endl;
-    std::cerr << "Validation: |" << validation_smi << "|" << std::endl; 
-    std::cerr << "Synthesized: |" << syn_smi << "|" << std::endl;
-
-    std::cerr << "Exiting..." << std::endl;
-    exit(0);
-}
-
-
 //
 // Initialize the linkers and rigids as required; the baseMolecules list will then be
 // used as a reference container throughout synthesis.
@@ -641,6 +1157,9 @@ void Instantiator::InitializeBaseMolecules(const std::vector<Rigid*>& rigids,
     // Clear the list just in case.
     baseMolecules.clear();
 
+    // To generate unique molecular ids
+    IdFactory moleculeIDFactory;
+
     // Assign the linkers and rigids unique ids; these correspond EXACTLY to the indices of
     // the containers used for determing molecular (non)-isomorphism.
     foreach_rigids(r_it, rigids)
@@ -666,6 +1185,7 @@ void Instantiator::InitializeBaseMolecules(const std::vector<Rigid*>& rigids,
     {
         (*m_it)->initFragmentDevices();
         (*m_it)->initGraphRepresentation();
+        (*m_it)->initAssembly();
     }
 }
 
@@ -685,7 +1205,7 @@ void Instantiator::SynthesizeWithMolecule(const Molecule* const currentMol, int
         //
         // Add the molecule to the next level queue; this depends on the level
         //
-        HandleNewMolecules(level_queues[level + 1], 0, filters[level + 1], newEdges);
+        HandleNewMolecules(level_queues[level + 1], filters[level + 1], newEdges);
     }
 }
 
@@ -708,106 +1228,65 @@ void *ProcessLevel(void *ptr_void)
     //
     //  recast variables for local use (from the spawned thread record we were passed)
     //
-    std::vector<Molecule*> *baseMols = &(This->baseMolecules);
-    std::queue<Molecule*> *inSet = &(This->level_queues[m-1]);
-    std::queue<Molecule*> *outSet = &(This->level_queues[m]);
-    pthread_mutex_t *in_lock = &(This->queue_locks[m-1]);
-    pthread_mutex_t *out_lock = &(This->queue_locks[m]);
-    bool* previousLevelComplete = &(This->completed_level[m-1]);
-    bool* thisLevelComplete = &(This->completed_level[m]);
+    SpillingQueue *inSet = &(This->level_queues[m-1]);
+    SpillingQueue *outSet = &(This->level_queues[m]);
 
     //
-    // A structure for sleeping for 0.1 seconds
+    // Keep consuming molecules until the previous level has closed its queue and
+    // this level has drained it. Waiting for input and waiting for room in the
+    // next level queue (backpressure) both block rather than poll.
     //
-    struct timespec sleepTime;
-    struct timespec remTime;     // Remaining time
-    sleepTime.tv_sec = 0;
-    sleepTime.tv_nsec = 100000000L; // 0.1 seconds
-
-    //
-    // Keep consuming molecules as long as the previous level is incomplete or this
-    // level queue contains molecules to process.
-    //
-    while (!(*previousLevelComplete) || !inSet->empty())
+    Molecule* molToProcess = 0;
+    while (inSet->pop(molToProcess))
     {
-        //
-        // Nothing to process, currently, but the level is incomplete.
-        //
-        if (inSet->empty())
+        // Stopping early: drain the queue so that the levels below complete.
+        if (This->stopping)
         {
-            nanosleep(&sleepTime, &remTime);
+            delete molToProcess;
+            continue;
         }
-        else
+
+        // The total over all threads, for display and the print rate.
+        This->stats.processed(m - 1);
+        unsigned long long levelCount = This->stats.getProcessed(m - 1);
+
+        if (levelCount % 500 == 0 || m <= 6)
         {
-            //
-            // If a greater level has elements in their queue, pause this thread for
-            // a while.
-            // Anything over level 13 should fly through.
-            //
-            bool process = false;
+            std::cout << "Took molecule " << levelCount
+                      << " off level " << m-1 << "; queue contains ("
+                      << inSet->size() << "); Overall Count: "
+                      << This->stats.get(SynthesisStatistics::INCLUDED) << std::endl;
+        }
+
+        //
+        // Process the molecule by composing it with all the base molecules.
+        //
+        int level = m - 1;
+        for (int mol = 0; mol < Molecule::baseMolecules.size(); mol++)
+        {
+            std::vector<EdgeAggregator*>* newEdges =
+                             molToProcess->Compose(*Molecule::baseMolecules[mol]);
 
-            if (m >= 13) process = true;
-            else if (This->level_queues[m].size() < Instantiator::MAX_QUEUE_SIZES[m])
-            {
-                process = true;
-            }
             //
-            // Process a molecule in the queue
+            // Add the molecule to the next level queue; this depends on the level
             //
-            if (!process)
-            {
-                sleep(5);
-            }
-            else if (process)
-            {
-                //
-                // Acquire a molecule to process.
-                //
-                pthread_mutex_lock(in_lock);
-                Molecule* molToProcess = inSet->front();
-                inSet->pop();
-                pthread_mutex_unlock(in_lock);
-                This->moleculeLevelCount[m-1]++;
-                This->overallMoleculeCount++;
-
-                if (This->overallMoleculeCount % 500 == 0 || m <= 6)
-                {
-                    std::cout << "Took molecule "
-                              << This->moleculeLevelCount[m - 1]
-                              << " off level " << m-1 << "; queue contains ("
-                              << inSet->size() << "); Overall Count: "
-                              << This->overallMoleculeCount << std::endl;
-                }
+            This->HandleNewMolecules(This->level_queues[level + 1],
+                                     This->filters[level + 1],
+                                     newEdges);
+        }
 
-                //
-                // Process the molecule by composing it with all the base molecules.
-                //
-                int level = m - 1;
-                for (int mol = 0; mol < Molecule::baseMolecules.size(); mol++)
-                {
-                    std::vector<EdgeAggregator*>* newEdges =
-                                     molToProcess->Compose(*Molecule::baseMolecules[mol]);
-
-                    //
-                    // Add the molecule to the next level queue; this depends on the level
-                    //
-                    This->HandleNewMolecules(This->level_queues[level + 1],
-                                             &This->queue_locks[level + 1],
-                                             This->filters[level + 1],
-                                             newEdges);
-                }
+        // Follow the memory budget; waiting producers are woken if room was made.
+        if (This->queueController.sample()) This->ApplyQueueCapacities();
 
-                // We have successfully processed this molecule;
-                // kill unneeded items in the molecule class.
-                // Elements will persist in the MinimalMolecule representation
-                // in the hypergraph.
-                delete molToProcess;
-            }
-        }
+        // We have successfully processed this molecule;
+        // kill unneeded items in the molecule class.
+        // Elements will persist in the MinimalMolecule representation
+        // in the hypergraph.
+        delete molToProcess;
     }
 
     // Indicate this level is complete.
-    *thisLevelComplete = true;
+    outSet->close();
 
     // Zip the smi file.
     //if (m == Options::SMI_LEVEL_BOUND + 1) This->writer->IndicateSMIwritingComplete();
@@ -817,9 +1296,11 @@ void *ProcessLevel(void *ptr_void)
     if (m > 2) args->graph->killLevel(m-1);
 
     std::cerr << "Level " << (m-1) << " created "
-              << This->moleculeLevelCount[m-1] << " molecules." << std::endl; 
+              << This->stats.getProcessed(m - 1) << " molecules." << std::endl; 
 
     std::cerr << "Level " << m << " complete." << std::endl; 
+
+    return 0;
 }
 
 
@@ -834,12 +1315,12 @@ MoleculeHashHypergraph* Instantiator::ThreadedInstantiate(std::vector<Linker*>&
     InitializeSynthesis(linkers, rigids);
 
     // 1-Molecules and 2-Molecules have been processed.
-    completed_level[0] = true;
-    completed_level[1] = true;
-    completed_level[2] = true;
+    level_queues[0].close();
+    level_queues[1].close();
+    level_queues[2].close();
 
     // Indicate size of 1-M and 2-M lists
-    moleculeLevelCount[1] = baseMolecules.size();
+    stats.addProcessed(1, baseMolecules.size());
 
     //
     // For each level, start a thread and compose the elements with the base set of molecules.
@@ -860,7 +1341,7 @@ MoleculeHashHypergraph* Instantiator::ThreadedInstantiate(std::vector<Linker*>&
     std::cout << "Level\t" << "# Molecules" << std::endl; 
     for (int m = 1; m <= HIERARCHICAL_LEVEL_BOUND; m++)
     {
-       std::cout << m << "\t" << moleculeLevelCount[m] << std::endl; 
+       std::cout << m << "\t" << stats.getProcessed(m) << std::endl; 
     }
 
     // Tell the output engine we have completed synthesis.
@@ -35,7 +35,13 @@
 #include "IdFactory.h"
 #include "OBWriter.h"
 #include "TimedHashMap.h"
+#include "SpillingQueue.h"
+#include "CounterRng.h"
+#include "SynthesisStatistics.h"
 #include "bloom_filter.hpp"
+#include "Checkpoint.h"
+#include "QueueController.h"
+#include "TargetSet.h"
 
 
 
@@ -50,28 +56,21 @@ struct Instantiator_ProcessLevel_Thread_Args
 class Instantiator
 {
   private:
-    // Create necessary synthesis containers and init the linkers and rigids
-    void InitializeBaseMolecules(const std::vector<Rigid*>& rigids,
-                                 const std::vector<Linker*>& linkers,
-                                 std::vector<Molecule*>& baseMolecules);
-
     void InitializeSynthesis(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids);
 
-    // To generate unique molecular ids
-    IdFactory moleculeIDFactory;
-
     // Contains all processed clauses and relationships amongst the clauses
     MoleculeHashHypergraph*  graph;
 
     // debug stream
     std::ostream& ds;
 
-    void HandleNewMolecules(std::queue<Molecule*>& worklist,
-                            pthread_mutex_t* wl_lock,
+    void HandleNewMolecules(SpillingQueue& worklist,
                             bloom_filter* const levelFilter,
                             std::vector<EdgeAggregator*>* newEdges);
 
     void SynthesizeWithMolecule(const Molecule* const currentMol, int level);
+
+    static void GetProperties(const Molecule& mol, PropertyRow& row);
 	
     void AddEdge(const std::vector<unsigned int>& antecedent,
                  unsigned int consequent,
@@ -90,26 +89,44 @@ class Instantiator
     void InitOverallFilter();
     void InitLevelFilters();
 
+    // Release the levels and report once every queue has been processed (serial).
+    void CompleteSerialSynthesis();
+
+    // Compose each molecule of a previous run's binary output file with the added fragments.
+    bool ExtendPreviousOutput(const std::string& fileName,
+                              unsigned previousLibrary,
+                              const std::vector<unsigned>& previousIds,
+                              const std::vector<Molecule*>& added,
+                              unsigned& processedMols);
+
+    //
+    // Checkpoints (serial): the level being processed, the queued molecules,
+    // the bloom filters, the counts, and the output position.
+    //
+    bool CheckpointDue() const;
+    void WriteCheckpoint(int level, unsigned processedMols);
+    bool RestoreCheckpoint(int& level, unsigned& processedMols);
+    void ResumeSynthesis(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids,
+                         int& level, unsigned& processedMols);
+
+    // When the next periodic checkpoint is due
+    time_t nextCheckpoint;
+
     // Lock the hypergraph (for adding)
     pthread_mutex_t graph_lock;
 
-    // A list of locks for all of the producer-consumer queues.
-    pthread_mutex_t* queue_locks;
-
     // All of the hierarchical level threads.
     pthread_t* queue_threads;
 
-    // Indicator that a level has completed processing.
-    bool* completed_level;
-
-    // The actual producer-consumer queue for each level.
-    std::queue<Molecule*>* level_queues;
+    // The actual producer-consumer queue for each level; a level is complete
+    // when its queue has been closed and drained.
+    SpillingQueue* level_queues;
 
     // A bloom filter for each level beyond.
-    std::vector<bloom_filter*> filters;
+    std::vector<PersistentBloomFilter*> filters;
 
     // A bloom filter for each level beyond.
-    bloom_filter* overall_filter;
+    PersistentBloomFilter* overall_filter;
 
     // array of args for each level thread
     Instantiator_ProcessLevel_Thread_Args *arg_pointer;
@@ -117,41 +134,47 @@ class Instantiator
     // set of linkers and rigids (1-molecules)
     std::vector<Molecule*> baseMolecules;
 
-    // Molecules per level (count) for debug
-    int* moleculeLevelCount;
-    unsigned long long overallMoleculeCount;
+    // Molecule counts (processed per level, included, excluded, filtered)
+    SynthesisStatistics stats;
 
     // For output of molecules on the fly.
     OBWriter* const writer;
 
-    // How many molecules were excluded using probabilistic techniques
-    unsigned excluded;
+    // Stateless generator for probabilistic exclusion; safe to share among level threads.
+    const CounterRng exclusionRng;
 
-    // The maximum number of molecules allowable in a queue.
+    // The maximum number of molecules allowable in a queue, by default.
     static const unsigned MAX_QUEUE_SIZES[22];
 
+    // The current limits; these follow the memory budget when one is given.
+    QueueController queueController;
+
+    // Threaded: set the level queue capacities to the current limits.
+    void ApplyQueueCapacities();
+
     // The expected number of molecules in a level, at maximum.
     static const unsigned long long LEVEL_SIZES[22]; 
 
-    // On the fly validation of molecules synthesized;
-    // Exits if the validation molecule was generated.
-    void Validate(const std::string& syn_smi) const;
+    // The molecules sought on the fly (-targets); synthesis stops once all are found.
+    TargetSet* targets;
 
-    // The molecule to validate
-    std::string validation_smi;
+    // Set when synthesis is to end early; the level queues are then drained.
+    volatile bool stopping;
 
   public:
     Instantiator(OBWriter*const obWriter, std::ostream& out = std::cout);
 
+    // Seek the given targets while synthesizing.
+    void SetTargets(TargetSet* theTargets) { targets = theTargets; }
+
     ~Instantiator()
     {
         delete[] level_queues;
-        delete[] moleculeLevelCount;
         delete graph;
 
         // Delete the Bloom filters.
         delete overall_filter;
-        for (std::vector<bloom_filter*>::iterator it = filters.begin(); it != filters.end(); it++)
+        for (std::vector<PersistentBloomFilter*>::iterator it = filters.begin(); it != filters.end(); it++)
         {
             if (*it != 0) delete *it;
         }
@@ -162,9 +185,7 @@ class Instantiator
         //
         if (Options::THREADED)
         {
-            delete[] queue_locks;
             delete[] queue_threads;
-            delete[] completed_level;
             delete[] arg_pointer;
         }
     }
@@ -177,11 +198,23 @@ class Instantiator
     MoleculeHashHypergraph* SerialInstantiate(std::vector<Linker*>& linkers,
                                               std::vector<Rigid*>& rigids);
 
+    // Serial synthesis of only the molecules containing a fragment beyond the leading
+    // rigids and linkers, seeded from the binary output (-extend) of a run over those.
+    MoleculeHashHypergraph* IncrementalInstantiate(std::vector<Linker*>& linkers,
+                                                   std::vector<Rigid*>& rigids,
+                                                   unsigned numPreviousRigids,
+                                                   unsigned numPreviousLinkers);
+
     // Recursive assistant for serial processing.
     void SerialInstantiateHelper(int level, unsigned& processedMols);
 
-    unsigned getIncluded() const { return overallMoleculeCount; }
-    unsigned getExcluded() const { return excluded; }
+    SynthesisStatistics::Snapshot getStatistics() const { return stats.snapshot(); }
+
+    // Create necessary synthesis containers and init the linkers and rigids;
+    // also used to decode binary output against the same fragments.
+    static void InitializeBaseMolecules(const std::vector<Rigid*>& rigids,
+                                        const std::vector<Linker*>& linkers,
+                                        std::vector<Molecule*>& baseMolecules);
 
     // thread must be implemented as friend class
     friend void *ProcessLevel(void * args); // worker thread
@@ -19,7 +19,6 @@
 #include <iostream>
 #include <string>
 #include <map>
-#include <sstream>
 
 
 #include <openbabel/mol.h>
@@ -30,51 +29,47 @@
 #include "LinkerConnectableAtom.h"
 
 
-Linker::Linker(OpenBabel::OBMol* obmol, const std::string& name) : Molecule(obmol, name)
+Linker::Linker(OpenBabel::OBMol* obmol, const std::string& name,
+               const SdfRecord& record) : Molecule(obmol, name)
 {
-    //
-    // Acquire the comment data, make a copy, parse that comment.
-    //
-    OpenBabel::OBCommentData* comment = static_cast<OpenBabel::OBCommentData*>(obmol->GetData("Comment"));
+    // The appendix is parsed in place from the input file.
+    parseAppendix(record, obmol->NumAtoms());
 
-    std::string commentStr = comment->GetData();
-
-    parseAppendix(commentStr, obmol->NumAtoms());
+    // Lipinski descriptors by atom contribution; OpenBabel is not consulted.
+    initLipinski();
 
     // if (Options::OPENBABEL) OBWriter::ScrubAndConvertToSMIInternal(obmol, this->smi); 
 }
 
 //
-// Parse suffix to add max connection for each atom.
+// Parse the first data item to add max connection for each atom.
 //
-void Linker::parseAppendix(std::string& suffix, int numAtoms)
+void Linker::parseAppendix(const SdfRecord& record, int numAtoms)
 {
-    // std::cerr << "Linker::parseAppendix: " << suffix << "|" << std::endl;
-
-    // Use a string stream instead of manipulatiing the string
-    std::stringstream suffStream(suffix);
-
-    //
-    // Read until we get "> <"
-    //
-    std::string line = ""; 
-    while(line.find("> <") == std::string::npos)
+    TextView item;
+    if (!record.dataItem(0, item))
     {
-        getline(suffStream, line);
+        std::cerr << "Linker: no connection data item" << std::endl;
+        return;
     }
 
+    TextCursor cursor(item);
+
     //
     // Now, read the MAX Connections for each atom.
     //
     int maxConnections = -1;
-    std::string atomType;
+    TextView atomType;
 
     for(int x = 0; x < numAtoms; x++)
     {
-        suffStream >> maxConnections;
-        suffStream >> atomType;
+        if (!cursor.nextInt(maxConnections) || !cursor.nextToken(atomType))
+        {
+            std::cerr << "Linker: expected " << numAtoms << " atoms; found " << x << std::endl;
+            return;
+        }
 
         // A linker can link to any atom.
-        this->atoms.push_back(new LinkerConnectableAtom(maxConnections, atomType, this));
+        this->atoms.push_back(new LinkerConnectableAtom(maxConnections, atomType.str(), this));
     }
 }
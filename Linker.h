@@ -28,7 +28,7 @@
 class Linker : public Molecule
 {
   public:
-    Linker(OpenBabel::OBMol*, const std::string& name);
+    Linker(OpenBabel::OBMol*, const std::string& name, const SdfRecord& record);
     Linker() {}
 
     ~Linker() {}
@@ -43,7 +43,7 @@ class Linker : public Molecule
     }
 
   protected:
-    virtual void parseAppendix(std::string& suffix, int numAtoms = -1);
+    virtual void parseAppendix(const SdfRecord& record, int numAtoms = -1);
 };
 
 #endif
@@ -53,6 +53,20 @@ LinkerConnectableAtom::LinkerConnectableAtom(int maxConn, const std::string& aTy
 
 /**********************************************************************************/
 
+LinkerConnectableAtom::LinkerConnectableAtom(int maxConn, const AtomT& aType,
+                                             const Linker* const owner)
+{
+    this->atomType = aType;
+    this->ownerFragment = (Molecule*)owner;
+
+    this->theAtom.connectionID = 0;
+    this->theAtom.maxConnect = maxConn;
+    this->theAtom.numExternalConnections = 0;
+    this->theAtom.numAllowConns = 1;
+}
+
+/**********************************************************************************/
+
 LinkerConnectableAtom::~LinkerConnectableAtom()
 {
 }
@@ -43,6 +43,7 @@ class LinkerConnectableAtom : public ConnectableAtom
 
     LinkerConnectableAtom(const LinkerConnectableAtom* const);
     LinkerConnectableAtom(int maxConn, const std::string&, const Linker* const owner);
+    LinkerConnectableAtom(int maxConn, const AtomT&, const Linker* const owner);
     ~LinkerConnectableAtom();
 
     std::string toString() const;
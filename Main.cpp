@@ -51,6 +51,10 @@
 #include "OBWriter.h"
 #include "Options.h"
 #include "Validator.h"
+#include "TargetSet.h"
+#include "BlockReader.h"
+#include "FragmentLoader.h"
+#include "FragmentLibrary.h"
 
 
 //
@@ -72,181 +76,41 @@
 std::vector<Linker*> linkers;
 std::vector<Rigid*> rigids;
 
-void Cleanup(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids);
-
-bool splitMolecule(std::ifstream& infile, std::string& name,
-                   std::string& prefix, std::string& suffix)
-{
-    prefix = "";
-    suffix = "";
-
-    std::string line = "";
-
-    // Eat #### in large files (if it exists)
-    eatWhiteLines(infile); 
-    if (infile.peek() == '#')
-    {
-        getline(infile, line);
-        name = line;
-        eatWhiteLines(infile);
-    }
-
-    getline(infile, line);
-    prefix += line + '\n';
-
-    // Nothing left to read...
-    if (infile.eof() || infile.fail()) return false;
-
-    // Read the prefix (end indicated by END)
-    while(line.find("END") == std::string::npos)
-    {
-        getline(infile, line);
-        prefix += line + '\n';
-    }
-
-    // Add '$$$$' to the prefix.
-    // prefix += "\n$$$$";
-
-    // Set suffix equal to remainder of the file
-    while (line.find("$$$$") == std::string::npos)
-    {
-        getline(infile, line);
-        suffix += line + '\n';
-    }
+// The leading rigids and linkers a previous run was synthesized from (-extend)
+unsigned numPreviousRigids = 0;
+unsigned numPreviousLinkers = 0;
 
-    return true;
-}
+void Cleanup(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids);
+int DecodeBinaryOutput(const std::string& fileName);
 
-Molecule* createLocalMolecule(OpenBabel::OBMol* mol, MoleculeT mType,
-                              const std::string& name, std::string& suffix)
+//
+// Parse each input data files; a current precompiled library (-lib) is used instead when given.
+// Added fragments (-add) follow, so the ids of the others are as before.
+//
+bool readInputFiles(const Options& options)
 {
-    //
-    // Add the suffix as comment data to the actual OBMol object.  
-    //
-    OpenBabel::OBCommentData* cData = new OpenBabel::OBCommentData();
-    cData->SetAttribute("Comment");
-    cData->SetData(suffix);
-    mol->SetData(cData);
+    bool loaded = false;
 
-    //
-    // Create this particular molecule type based on the name of the file.
-    //
-    if (mType == LINKER)
-    {
-        return new Linker(mol, name);
-    }
-    else if (mType == RIGID)
+    if (options.libraryFile != "" && FragmentLibrary::IsCurrent(options.libraryFile, options.inFiles))
     {
-        return new Rigid(mol, name);
+        std::cerr << "Using fragment library " << options.libraryFile << std::endl;
+        loaded = FragmentLibrary::Read(options.libraryFile, rigids, linkers);
     }
-    
-    return 0;
-}
-
-void addMolecule(char type, Molecule* molecule)
-{
-    if (type == 'l')
-    {
-        linkers.push_back(static_cast<Linker*>(molecule));        
-    }
-    else if (type == 'r')
-    {
-        rigids.push_back(static_cast<Rigid*>(molecule));        
-    }
-}
-
-void readMoleculeFile(const char* fileName)
-{
-    //
-    // Input parser conversion functionality for Open babel
-    //
-    OpenBabel::OBConversion obConversion;
-    obConversion.SetInFormat("SDF");
-
-    //
-    // Open the file, split the current molecule into Molecule Data (prefix)
-    // and Our Data (Suffix)
-    //
-    std::ifstream infile;
-    infile.open(fileName);
-
-    std::string name = "UNKNOWN";
-    std::string prefix = "";
-    std::string suffix = "";
-    
-    while(splitMolecule(infile, name, prefix, suffix))
+    else
     {
-        //
-        // If the name of molecule is not given, overwrite it with the name of the file.
-        //
-        if (name == "UNKNOWN")
-        {
-           name = "####   ";
-           name += fileName;
-           name += "    ####";
-        }
-
-        if (g_debug_output) std::cerr << "Name: " << std::endl << name << std::endl;
-        if (g_debug_output) std::cerr << "Prefix: " << std::endl << prefix << std::endl;
-        if (g_debug_output) std::cerr << "Suffix: " << std::endl << suffix << std::endl;
-
-        // Create and parse using Open Babel
-        OpenBabel::OBMol* mol = new OpenBabel::OBMol();
-        bool notAtEnd = obConversion.ReadString(mol, prefix);
-
-        // Assign all needed data to the molecule (comment data)
-        Molecule* local = createLocalMolecule(mol, fileName[0] == 'l' ? LINKER : RIGID,
-                                              name, suffix);
-
-//std::cerr << *local << std::endl;
-
-        // calculate the molecular weight, H donors and acceptors and the plogp
-        //local->openBabelPredictLipinski();
-
-        // add to logfile
-        if (Molecule::isOpenBabelLipinskiCompliant(*mol))
+        if (options.libraryFile != "")
         {
-            std::ofstream logfile("synth_log_initial_fragments_logfile.txt",
-                                  std::ofstream::out | std::ofstream::app); // append
-            logfile << fileName << "\nMolWt = " << local->getMolWt() << "\n";
-            logfile << "HBD = " << local->getHBD() << "\n";
-            logfile << "HBA1 = " << local->getHBA1() << "\n";
-            logfile << "logP = " << local->getlogP() << "\n";
-            logfile << std::endl;
-            logfile.close();
+            std::cerr << "Fragment library " << options.libraryFile
+                      << " is missing or out of date; reading the SDF files." << std::endl;
         }
-        else std::cerr << "Main: predictLipinski failed somehow!" << endl;
 
-        if (g_debug_output) std::cout << "Local: " << *local << "|" << std::endl;
-    
-        // Add to the linker or rigid list as needed.
-        addMolecule(fileName[0], local); 
-
-        // We don't keep a copy of the OpenBabel molecule anymore.
-        delete mol;
+        loaded = LoadFragmentFiles(options.inFiles, rigids, linkers);
     }
-}
 
+    numPreviousRigids = rigids.size();
+    numPreviousLinkers = linkers.size();
 
-//
-// Parse each input data files
-//
-bool readInputFiles(const Options& options)
-{
-    for (std::vector<std::string>::const_iterator it = options.inFiles.begin();
-         it != options.inFiles.end(); it++)
-    {
-        if ((*it)[0] != 'l' && (*it)[0] != 'r')
-        {
-            cerr << "Unexpected file prefix: \'" << (*it)[0]
-                 << "\' with file " << *it << endl;
-            return false;
-        }
-
-        readMoleculeFile((*it).c_str());
-    }
-
-    return true;
+    return loaded && (options.addFiles.empty() || LoadFragmentFiles(options.addFiles, rigids, linkers));
 }
 
 
@@ -278,6 +142,18 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    //
+    // Decode binary output rather than synthesize.
+    //
+    if (options.decodeFile != "")
+    {
+        if (!readInputFiles(options)) return 1;
+
+        int ret = DecodeBinaryOutput(options.decodeFile);
+        Cleanup(linkers, rigids);
+        return ret;
+    }
+
 /*
     if (!options.AnalyzeEnvironment())
     {
@@ -297,6 +173,26 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    if (Options::CHECKPOINT && Options::THREADED)
+    {
+        std::cerr << "Checkpoints are only supported in serial execution; exiting." << std::endl;
+        return 1;
+    }
+
+    if (Options::EXTEND_DIR != "" &&
+        (Options::THREADED || Options::CHECKPOINT || options.addFiles.empty()))
+    {
+        std::cerr << "Extending a run requires serial execution without checkpoints"
+                  << " and the fragment files to add (-add); exiting." << std::endl;
+        return 1;
+    }
+
+    if (Options::TARGET_DIRECTED && options.targetsFile == "")
+    {
+        std::cerr << "Target-directed synthesis requires the targets (-targets); exiting." << std::endl;
+        return 1;
+    }
+
     // std::cout << "SMI Comparison Level: " << Options::SMI_LEVEL_BOUND << std::endl;
     std::cout << "Probability Filtration Level: "
               << Options::PROBABILITY_PRUNE_LEVEL_START << std::endl;
@@ -331,19 +227,43 @@ int main(int argc, char** argv)
     // The main object that performs synthesis.
     Instantiator instantiator(writer, cout); //, options.validationFile);
 
+    // Molecules sought on the fly; synthesis stops once all are found.
+    TargetSet targets;
+    if (options.targetsFile != "")
+    {
+        if (!targets.load(options.targetsFile)) return 1;
+
+        // Bound each target by the fragments; base ids are positional (rigids, then linkers).
+        if (Options::TARGET_DIRECTED)
+        {
+            std::vector<Molecule*> fragments(rigids.begin(), rigids.end());
+            fragments.insert(fragments.end(), linkers.begin(), linkers.end());
+
+            targets.decompose(fragments);
+        }
+
+        instantiator.SetTargets(&targets);
+    }
+
     // Instantiation build the hypergraph; this is the main data structure for the
     // resultant molecules.
     // Also creates the hypergraph using threaded or non-threaded techniques.
     MoleculeHashHypergraph* graph;
-    if (Options::THREADED) graph = instantiator.ThreadedInstantiate(linkers, rigids);
+    if (Options::EXTEND_DIR != "")
+    {
+        graph = instantiator.IncrementalInstantiate(linkers, rigids,
+                                                    numPreviousRigids, numPreviousLinkers);
+    }
+    else if (Options::THREADED) graph = instantiator.ThreadedInstantiate(linkers, rigids);
     else if (Options::SERIAL) graph = instantiator.SerialInstantiate(linkers, rigids);
 
     // std::cout << "Hypergraph contains (" << graph->currentSize()
     //           << ", " << graph->nonKilledSize()<< ") nodes" << std::endl;
 
 
-    unsigned inc = instantiator.getIncluded();
-    unsigned exc = instantiator.getExcluded();
+    SynthesisStatistics::Snapshot stats = instantiator.getStatistics();
+    unsigned long long inc = stats.included();
+    unsigned long long exc = stats.excluded();
 
     std::cout << "Excluded (" << exc << "); Included (" << inc << ") \t Excluded: "
               << ((double)(exc) / (exc + inc)) << "\%" << std::endl;  
@@ -353,10 +273,26 @@ int main(int argc, char** argv)
     // std::cout << OBWriter::NumCompliantMolecules()
     //          << " are Lipinski compliant molecules" << std::endl;
 
+    if (!targets.empty())
+    {
+        std::ofstream logfile("Targets_logfile.txt", std::ofstream::out | std::ofstream::app); // append
+        targets.report(logfile);
+        logfile.close();
+
+        std::cout << targets.numFound() << " of " << targets.size()
+                  << " targets synthesized" << std::endl;
+
+        if (Options::TARGET_DIRECTED)
+        {
+            std::cout << stats.counters[SynthesisStatistics::TARGET_PRUNED]
+                      << " molecules could not reach a target" << std::endl;
+        }
+    }
+
     //
     // Validate the molecules specified in the validation file (command-line -v)
     //
-    Validator validator(OBWriter::compliantMols);
+    Validator validator(OBWriter::compliantFingerprints);
     validator.Validate(options.validationFile);
 
     // Deleting the writer will kill the thread pool.
@@ -374,6 +310,53 @@ std::cerr << "Exiting the main thread." << std::endl;
     return 0;
 }
 
+//
+// Print each fragment assembly in a binary output file as SMILES (or SDF);
+// the fragments must be the same (and in the same order) as those synthesized from.
+//
+int DecodeBinaryOutput(const std::string& fileName)
+{
+    BlockReader reader;
+    if (!reader.open(fileName)) return 1;
+
+    if (reader.getEncoding() != BlockFormat::ENCODING_ASSEMBLY)
+    {
+        std::cerr << fileName << " does not contain fragment assemblies." << std::endl;
+        return 1;
+    }
+
+    std::vector<Molecule*> baseMolecules;
+    Instantiator::InitializeBaseMolecules(rigids, linkers, baseMolecules);
+
+    if (reader.getLibrary() != Molecule::LibraryHash())
+    {
+        std::cerr << fileName << " was synthesized from a different set of fragments." << std::endl;
+        return 1;
+    }
+
+    for (unsigned b = 0; b < reader.numBlocks(); b++)
+    {
+        std::vector<std::string> records;
+        if (!reader.readBlock(b, records)) return 1;
+
+        for (unsigned r = 0; r < records.size(); r++)
+        {
+            std::string molecule;
+            if (!Molecule::WriteAssembly(records[r], Options::DECODE_SDF, molecule))
+            {
+                std::cerr << "Molecule " << reader.block(b).firstId + r
+                          << " has an invalid assembly." << std::endl;
+                return 1;
+            }
+
+            std::cout << molecule << std::endl;
+            if (Options::DECODE_SDF) std::cout << "$$$$" << std::endl;
+        }
+    }
+
+    return 0;
+}
+
 void Cleanup(std::vector<Linker*>& linkers, std::vector<Rigid*>& rigids)
 {
     for (int ell = 0; ell < linkers.size(); ell++)
@@ -22,7 +22,6 @@
 #include <iomanip>
 #include <pthread.h>
 #include <cmath>
-#include <gsl/gsl_rng.h>
 
 
 #include<openbabel/descriptor.h>
@@ -48,6 +47,7 @@
 #include "MinimalMolecule.h"
 #include "SmiMinimalMolecule.h"
 #include "EdgeDatabase.h"
+#include "BlockFormat.h"
 
 
 // global static lock for openbabel
@@ -69,7 +69,9 @@ static const unsigned int NO_CONNECTION = -1;
 
 Molecule::Molecule() : // obmol(0),
                        //type(COMPLEX),
-                       fragmentCounter(0)
+                       fragmentCounter(0),
+                       numRigidFragments(0),
+                       numLinkerFragments(0)
 {
     init_openbabel_lock();
 }
@@ -112,15 +114,15 @@ Molecule::Molecule(OpenBabel::OBMol* mol, const std::string& theSMI) : //, Molec
     //smi(theSMI),
     fingerprint(0),  
     //type(t),
-    fragmentCounter(0)
+    fragmentCounter(0),
+    numRigidFragments(0),
+    numLinkerFragments(0)
 {
     init_openbabel_lock();
 
     // Create the initial atom / bond data based on obmol.
+    // The Lipinski descriptors follow once the atoms are typed (initLipinski).
     localizeOBMol(mol);
-
-    // Acquire the OpenBabel Lipinski descriptor values
-    openBabelPredictLipinski(mol);
 }
 
 
@@ -180,6 +182,102 @@ std::string Molecule::ConstructSMI() const
 }
 
 
+//
+// A base molecule is its own (single fragment) assembly.
+//
+void Molecule::initAssembly()
+{
+    assembly.clear();
+    PutVarint(assembly, uniqueIndexID);
+}
+
+//
+// Replay the compositions recorded in the assembly against the base molecules.
+//
+Molecule* Molecule::Reassemble(const std::string& assembly)
+{
+    const unsigned char* in = (const unsigned char*)assembly.data();
+    const unsigned char* end = in + assembly.size();
+
+    unsigned fragment;
+    if (!GetVarint(in, end, fragment) || fragment >= baseMolecules.size()) return 0;
+
+    const Molecule* current = baseMolecules[fragment];
+    Molecule* composed = 0;
+
+    while (in < end)
+    {
+        unsigned thisAtom;
+        unsigned thatAtom;
+
+        if (!GetVarint(in, end, thisAtom) ||
+            !GetVarint(in, end, fragment) ||
+            !GetVarint(in, end, thatAtom) ||
+            fragment >= baseMolecules.size() ||
+            thisAtom >= current->atoms.size() ||
+            thatAtom >= baseMolecules[fragment]->atoms.size())
+        {
+            delete composed;
+            return 0;
+        }
+
+        // Atom indices are 1-based in composition (as with OpenBabel).
+        Molecule* next = current->ComposeToNewLocalMolecule(*baseMolecules[fragment],
+                                                            thisAtom + 1,
+                                                            thatAtom + current->atoms.size() + 1);
+        delete composed;
+        composed = next;
+        current = next;
+    }
+
+    return composed;
+}
+
+bool Molecule::WriteAssembly(const std::string& assembly, bool asSDF, std::string& out)
+{
+    const unsigned char* in = (const unsigned char*)assembly.data();
+    const unsigned char* end = in + assembly.size();
+
+    unsigned fragment;
+    if (!GetVarint(in, end, fragment) || fragment >= baseMolecules.size()) return false;
+
+    // A single fragment is the base molecule itself.
+    Molecule* composed = 0;
+    if (in < end && (composed = Reassemble(assembly)) == 0) return false;
+
+    const Molecule* current = composed != 0 ? composed : baseMolecules[fragment];
+
+    if (asSDF) Conformer::Write(*current, out);
+    else out = current->ConstructSMI();
+
+    delete composed;
+
+    return true;
+}
+
+//
+// Hash of the base molecules, in order; assemblies are only meaningful
+// against the library they were created with.
+//
+unsigned Molecule::LibraryHash()
+{
+    return LibraryHash(baseMolecules);
+}
+
+unsigned Molecule::LibraryHash(const std::vector<Molecule*>& fragments)
+{
+    std::string library;
+    for (std::vector<Molecule*>::const_iterator m_it = fragments.begin(); m_it != fragments.end(); m_it++)
+    {
+        library += (*m_it)->ConstructSMI();
+        library += '\n';
+    }
+
+    unsigned long long hash = CounterRng::HashKey(library);
+
+    return (unsigned)(hash ^ (hash >> 32));
+}
+
 void Molecule::initFragmentDevices()
 {
     initFragmentInfo();
@@ -189,6 +287,10 @@ void Molecule::initFragmentDevices()
     // Indicate we are using this fragment
     fragmentCounter[uniqueIndexID] = 1;
 
+    // Rigids precede linkers.
+    if (uniqueIndexID < LINKER_INDEX_START) numRigidFragments = 1;
+    else numLinkerFragments = 1;
+
     //
     // Create the connection identifiers for this linker / rigid
     //
@@ -288,57 +390,66 @@ void Molecule::SetBaseMoleculeInfo(const std::vector<Molecule*> baseMols,
     Molecule::NUM_UNIQUE_FRAGMENTS = numRigids + numLinkers;
 }
 
-void Molecule::openBabelPredictLipinski(OpenBabel::OBMol* obmol)
+//
+// Sum the atom contributions of a fragment (once, at load).
+//
+void Molecule::initLipinski()
 {
-    pthread_mutex_lock(&Molecule::openbabel_lock);
-
-    // calculate the molecular weight, H donors and acceptors and the plogp
-    OpenBabel::OBDescriptor* pDesc1 = OpenBabel::OBDescriptor::FindType("HBD");
-    OpenBabel::OBDescriptor* pDesc2 = OpenBabel::OBDescriptor::FindType("HBA1");
-    OpenBabel::OBDescriptor* pDesc4 = OpenBabel::OBDescriptor::FindType("logP");
-
-    if (!pDesc1) cerr << "HBD not found" << endl;
-    if (!pDesc2) cerr << "HBA1 not found" << endl;
-    if (!pDesc4) cerr << "logP not found" << endl;
-    if (!pDesc1 || !pDesc2 || !pDesc4) return;
+    Descriptors descriptors;
 
-    MolWt = obmol->GetMolWt();
-    HBD = pDesc1->Predict(obmol);
-    HBA1 = pDesc2->Predict(obmol);
-    logP = pDesc4->Predict(obmol);
+    for (unsigned a = 0; a < atoms.size() && a < atomStates.size(); a++)
+    {
+        descriptors.add(atoms[a]->getAtomType(), atomStates[a]);
+    }
 
-    pthread_mutex_unlock(&Molecule::openbabel_lock);
+    MolWt = descriptors.MolWt;
+    HBD = descriptors.HBD;
+    HBA1 = descriptors.HBA1;
+    logP = descriptors.logP;
 }
 
 //
 // Near the end of the synthesis process, there is little benefit 
 // to composing molecules if the two molecules will exceed the additive molecular weight.  
+// A single bond loses at most two hydrogens, donors, and acceptors, so this never
+// rejects a compliant composition.
 //
 bool Molecule::willExceedAdditiveThresholds(const Molecule &mol1, const Molecule &mol2)
 {
     // HBD 
-    if (0.41189 + 0.4898 * (mol1.getHBD() + mol2.getHBD()) > HBD_UPPERBOUND) return true;
+    if (mol1.getHBD() + mol2.getHBD() - Descriptors::MAX_BOND_HBD_LOSS > HBD_UPPERBOUND) return true;
 
     // HBA1
-    if (0.278 + 0.93778 * (mol1.getHBA1() + mol2.getHBA1()) > HBA1_UPPERBOUND) return true;
+    if (mol1.getHBA1() + mol2.getHBA1() - Descriptors::MAX_BOND_HBA1_LOSS > HBA1_UPPERBOUND) return true;
 
     // Molecular weight
-    if (6.6746 + 0.95965 * (mol1.getMolWt() + mol2.getMolWt()) > MOLWT_UPPERBOUND) return true;
+    if (mol1.getMolWt() + mol2.getMolWt() - Descriptors::MAX_BOND_MOLWT_LOSS > MOLWT_UPPERBOUND) return true;
 
     return false;
 }
 
-void Molecule::estimateLipinski(const Molecule& mol1, const Molecule &mol2)
+//
+// The descriptors of the parts, corrected at the two atoms bonded; their states
+// (this molecule's copies) are updated for the new bond. O(1) per composition.
+//
+void Molecule::composeLipinski(const Molecule& mol1, const Molecule &mol2, int thisAtom, int thatAtom)
 {
-    double calc_MolWt = mol1.getMolWt() + mol2.getMolWt();
-    double calc_HBD = mol1.getHBD() + mol2.getHBD();
-    double calc_HBA1 = mol1.getHBA1() + mol2.getHBA1();
-    double calc_logP = mol1.getlogP() + mol2.getlogP();
-
-    this->MolWt = 6.6746 + 0.95965 * calc_MolWt;
-    this->HBD = 0.41189 + 0.4898 * calc_HBD;
-    this->HBA1 = 0.278 + 0.93778 * calc_HBA1;
-    this->logP = 0.84121 + 0.59105 * calc_logP;
+    Descriptors descriptors;
+    descriptors.MolWt = mol1.getMolWt() + mol2.getMolWt();
+    descriptors.HBD = mol1.getHBD() + mol2.getHBD();
+    descriptors.HBA1 = mol1.getHBA1() + mol2.getHBA1();
+    descriptors.logP = mol1.getlogP() + mol2.getlogP();
+
+    if (thisAtom < atomStates.size() && thatAtom < atomStates.size())
+    {
+        descriptors.bond(atoms[thisAtom]->getAtomType(), atomStates[thisAtom],
+                         atoms[thatAtom]->getAtomType(), atomStates[thatAtom]);
+    }
+
+    this->MolWt = descriptors.MolWt;
+    this->HBD = descriptors.HBD;
+    this->HBA1 = descriptors.HBA1;
+    this->logP = descriptors.logP;
 }
 
 void Molecule::localizeOBMol(OpenBabel::OBMol* obmol)
@@ -360,6 +471,21 @@ void Molecule::localizeOBMol(OpenBabel::OBMol* obmol)
     }
 */
 
+    //
+    // Retain the (docked) coordinates of each atom.
+    //
+    for (int x = 1; x <= numOfAtoms; x++)
+    {
+        OpenBabel::OBAtom* oneObAtom = obmol->GetAtom(x);
+
+        this->coordinates.push_back(Point(oneObAtom->GetX(), oneObAtom->GetY(), oneObAtom->GetZ()));
+
+        // Explicit hydrogens are counted with their atom as well.
+        this->atomStates.push_back(AtomState(oneObAtom->ImplicitHydrogenCount() +
+                                             oneObAtom->ExplicitHydrogenCount(),
+                                             oneObAtom->GetHvyValence()));
+    }
+
     //
     // Translate the OB Bonds into our local bonds.
     //
@@ -780,6 +906,15 @@ Molecule* Molecule::ComposeToNewLocalMolecule(const Molecule& that,
 	// actual new bond (id, this-atom, that-atom, degree of bond)
     newLocal->bonds.push_back(Bond(thisAtomIndex - 1, thatAtomIndex - 1, 1));
 
+    newLocal->atomStates = this->atomStates;
+    newLocal->atomStates.insert(newLocal->atomStates.end(), that.atomStates.begin(), that.atomStates.end());
+
+    // Record the new bond: atom in this, the fragment, and the atom in that fragment.
+    newLocal->assembly = this->assembly;
+    PutVarint(newLocal->assembly, thisAtomIndex - 1);
+    PutVarint(newLocal->assembly, that.uniqueIndexID);
+    PutVarint(newLocal->assembly, thatAtomIndex - 1 - offset);
+
     // Init the fragment counter container.
     newLocal->initFragmentInfo();
 
@@ -788,6 +923,8 @@ Molecule* Molecule::ComposeToNewLocalMolecule(const Molecule& that,
     {
         newLocal->fragmentCounter[f] = this->fragmentCounter[f] + that.fragmentCounter[f];
     }
+    newLocal->numRigidFragments = this->numRigidFragments + that.numRigidFragments;
+    newLocal->numLinkerFragments = this->numLinkerFragments + that.numLinkerFragments;
 
     //
     // Add local information to the new molecule.
@@ -808,8 +945,8 @@ Molecule* Molecule::ComposeToNewLocalMolecule(const Molecule& that,
     // std::cout << "Fingerprint: |" << *(newLocal->fingerprint) << "|" << std::endl;
 
 
-    // Estimate the Lipinski parameters.
-    newLocal->estimateLipinski(*this, that);
+    // The Lipinski parameters: the parts, corrected at the new bond.
+    newLocal->composeLipinski(*this, that, thisAtomIndex - 1, thatAtomIndex - 1);
 
     return newLocal;
 }
@@ -901,7 +1038,7 @@ std::ostream& operator<< (std::ostream& os, const Molecule& mol)
 
 // *****************************************************************************
 
-void Molecule::WriteToOpenBabelFormat(std::string& str) const
+void Molecule::WriteToOpenBabelFormat(std::string& str, const std::vector<Point>* coordinates) const
 {
     std::ostringstream oss;
 
@@ -928,16 +1065,30 @@ void Molecule::WriteToOpenBabelFormat(std::string& str) const
     oss << std::setw(6) << "0999";
     oss << std::setw(6) << "V2000" << std::endl;
 
-    foreach_atoms(a_it, this->atoms)
+    for (unsigned a = 0; a < this->atoms.size(); a++)
     {
+        const Atom* atom = this->atoms[a];
+
         // Coordinates
-        oss << std::setw(10) << "0.0000";
-        oss << std::setw(10) << "0.0000";
-        oss << std::setw(10) << "0.0000";
+        if (coordinates != 0)
+        {
+            const Point& p = (*coordinates)[a];
+
+            oss << std::fixed << std::setprecision(4);
+            oss << std::setw(10) << p.x;
+            oss << std::setw(10) << p.y;
+            oss << std::setw(10) << p.z;
+        }
+        else
+        {
+            oss << std::setw(10) << "0.0000";
+            oss << std::setw(10) << "0.0000";
+            oss << std::setw(10) << "0.0000";
+        }
 
         oss << ' ';
 
-        std::string atomtype = (*a_it)->getAtomType().getAtomType();
+        std::string atomtype = atom->getAtomType().getAtomType();
         oss << atomtype;
         if (atomtype.size() == 1) oss << ' ';
 
@@ -979,29 +1130,104 @@ void Molecule::WriteToOpenBabelFormat(std::string& str) const
 
 
 //
-// Probability-related code for inclusion / exclusion of a molecule
+// The factors of the exclusion probability (ProbabilisticExclusion); those of
+// counts are tabulated below.
 //
-bool Molecule::ProbabilisticExclusion(const Molecule* const mol)
+static double RigidFactor(int numRigids)
 {
-    static bool init_rng = false;
-    static const gsl_rng_type* T;
-    static gsl_rng* rec;
-    if (!init_rng)
+    return NormPdf(numRigids, 3.209722, 1.079512);
+}
+
+static double LinkerFactor(int numLinkers)
+{
+    return LogisticPdf(numLinkers, 3.025175, 1.369960);
+}
+
+static double RatioFactor(int numLinkers, int numRigids)
+{
+    double log_ratio = log(((float)numLinkers) / ((float)numRigids));
+    return LogisticPdf(log_ratio, -0.084292, 0.460030);
+}
+
+static double HbdFactor(double hbd)
+{
+    return LogisticPdf(hbd, 1.937285, 0.762586);
+}
+
+static double HbaFactor(double hba)
+{
+    return LogisticPdf(hba, 6.056996, 1.312437);
+}
+
+//
+// The count factors for counts below MAX_COUNT, evaluated once by the same
+// functions; larger counts are evaluated directly. Donors and acceptors are
+// whole numbers (Descriptors.h), so their factors are tabulated as well.
+//
+class ExclusionTables
+{
+  public:
+    static const int MAX_COUNT = 32;
+
+    ExclusionTables()
+    {
+        for (int n = 0; n < MAX_COUNT; n++)
+        {
+            rigid[n] = RigidFactor(n);
+            linker[n] = LinkerFactor(n);
+            hbd[n] = HbdFactor(n);
+            hba[n] = HbaFactor(n);
+
+            for (int r = 0; r < MAX_COUNT; r++)
+            {
+                ratio[n][r] = RatioFactor(n, r);
+            }
+        }
+    }
+
+    double rigidFactor(int n) const { return n < MAX_COUNT ? rigid[n] : RigidFactor(n); }
+    double linkerFactor(int n) const { return n < MAX_COUNT ? linker[n] : LinkerFactor(n); }
+
+    double ratioFactor(int linkers, int rigids) const
     {
-        init_rng = true;
+        return linkers < MAX_COUNT && rigids < MAX_COUNT ? ratio[linkers][rigids]
+                                                         : RatioFactor(linkers, rigids);
+    }
 
-        gsl_rng_env_setup();
+    double hbdFactor(double value) const
+    {
+        return IsCount(value) ? hbd[(int)value] : HbdFactor(value);
+    }
 
-        T = gsl_rng_default;
-        rec = gsl_rng_alloc (T);
+    double hbaFactor(double value) const
+    {
+        return IsCount(value) ? hba[(int)value] : HbaFactor(value);
     }
 
-    int numLinkers;
-    int numUniqueLinkers;
-    int numRigids;
-    int numUniqueRigids;
+  private:
+    double rigid[MAX_COUNT];
+    double linker[MAX_COUNT];
+    double ratio[MAX_COUNT][MAX_COUNT];   // [linkers][rigids]
+    double hbd[MAX_COUNT];
+    double hba[MAX_COUNT];
 
-    mol->GetNumLinkersRigids(numLinkers, numUniqueLinkers, numRigids, numUniqueRigids);
+    static bool IsCount(double value) { return value >= 0 && value < MAX_COUNT && value == (int)value; }
+};
+
+static const ExclusionTables exclusionTables;
+
+//
+// Probability-related code for inclusion / exclusion of a molecule
+//
+// The draw is keyed by the molecule's dedup SMI string (ConstructSMI) so that the
+// decision for a given molecule depends only on the seed, not on which thread
+// reached it first. The string follows atom order, which follows the assembly.
+//
+bool Molecule::ProbabilisticExclusion(const Molecule* const mol,
+                                      const CounterRng& rng, const std::string& smi)
+{
+    int numLinkers = mol->numLinkerFragments;
+    int numRigids = mol->numRigidFragments;
 
     //
     // Acquire all of the probabilities associate with:
@@ -1017,37 +1243,43 @@ bool Molecule::ProbabilisticExclusion(const Molecule* const mol)
     double mwProb = NormPdf(mol->getMolWt(), 428.366043, 91.124687);
 
     //    (b) # rigid fragments
-    double numRigidProb = NormPdf(numRigids, 3.209722, 1.079512);
+    double numRigidProb = exclusionTables.rigidFactor(numRigids);
 
     //    (c) # linkers
-    double numLinkerProb = LogisticPdf(numLinkers, 3.025175, 1.369960);
+    double numLinkerProb = exclusionTables.linkerFactor(numLinkers);
 
     //    (d) log of ratio (linkers : rigids)
-    double log_ratio = log(((float)numLinkers) / ((float)numRigids));
-    double ratioProb = LogisticPdf(log_ratio, -0.084292, 0.460030);
+    double ratioProb = exclusionTables.ratioFactor(numLinkers, numRigids);
 
     //    (e) hydrogen binding donors
-    double hbdProb = LogisticPdf(mol->getHBD(), 1.937285, 0.762586);
+    double hbdProb = exclusionTables.hbdFactor(mol->getHBD());
 
     //    (f) hydrogen binding acceptor 1
-    double hbaProb = LogisticPdf(mol->getHBA1(), 6.056996, 1.312437);
+    double hbaProb = exclusionTables.hbaFactor(mol->getHBA1());
 
     // Acquire the (cumulative) join probability distribution
     double cumProb = mwProb * numRigidProb * numLinkerProb * ratioProb * hbdProb * hbaProb;
 
-    // Generate a random number between 0 and 1.
-    double randJointProb = 1;
-    for (int i = 0; i < 6; i++)
+    //
+    // Excluding when cumProb exceeds the product of six uniforms is equivalent to
+    // comparing a single uniform against the tail of a Gamma(6, 1) distribution:
+    //
+    //    P(U1 * ... * U6 < c) = c * sum_{k=0}^{5} x^k / k!,   where x = -ln c.
+    //
+    // The comparison is made in the log domain since cumProb may be very small.
+    //
+    if (cumProb >= 1) return true;
+    if (!(cumProb > 0)) return false;
+
+    double x = -log(cumProb);
+    double term = 1;
+    double tail = 1;
+    for (int k = 1; k < 6; k++)
     {
-        randJointProb *= gsl_rng_uniform(rec);
+        term *= x / k;
+        tail += term;
     }
 
-// std::cerr << cumProb << " < " << randJointProb << " : " << (cumProb > randJointProb) << std::endl;
-
-    // return false;
-
-    return cumProb > randJointProb; 
-    
-    // gsl_rng_free(rec);
+    return log(rng.uniform(smi)) < log(cumProb) + log(tail);
 }
 
@@ -39,12 +39,17 @@
 #include "SmiMinimalMolecule.h"
 #include "EdgeDatabase.h"
 #include "Utilities.h"
+#include "CounterRng.h"
+#include "SdfScanner.h"
+#include "Conformer.h"
+#include "Descriptors.h"
 using namespace OpenBabel;
 
 class EdgeAggregator;
 class Rigid;
 class Linker;
 class SimpleFragmentGraph;
+class FragmentLibrary;
 
 class Molecule
 {
@@ -70,6 +75,12 @@ class Molecule
     double getlogP() const { return logP; }
 
     int getNumberOfAtoms() const { return this->atoms.size(); }
+    const Atom* getAtom(int a) const { return this->atoms[a]; }
+
+    // The number of times base fragment f (its unique index id) occurs in this molecule.
+    unsigned getFragmentCount(unsigned f) const { return this->fragmentCounter[f]; }
+    int getNumRigids() const { return this->numRigidFragments; }
+    int getNumLinkers() const { return this->numLinkerFragments; }
     int getNumberOfBonds() const { return this->bonds.size(); }
 
     // OpenBabel::OBMol* getOpenBabelMol() const { return obmol; }
@@ -82,6 +93,15 @@ class Molecule
 
     std::string toString() const;
     friend std::ostream& operator<< (std::ostream& os, const Molecule& mol);
+
+    // Stores and restores parsed fragments (see FragmentLibrary.h)
+    friend class FragmentLibrary;
+
+    // Lays out synthesized molecules from the fragment poses (see Conformer.h)
+    friend class Conformer;
+
+    // Fingerprints the atom and bond tables (see Fingerprint.h)
+    friend class Fingerprint;
     virtual bool operator==(const Molecule& that) const;
     std::vector<EdgeAggregator*>* Compose(const Molecule&) const;
 
@@ -90,9 +110,15 @@ class Molecule
                              int& numRigids, int& numUniqueRigids) const;
 
 
-    void openBabelPredictLipinski(OpenBabel::OBMol* obmol);
     static bool isOpenBabelLipinskiCompliant(OpenBabel::OBMol& mol);
-    void estimateLipinski(const Molecule &mol1, const Molecule &mol2);
+
+    // Lipinski descriptors of a fragment by atom contribution (see Descriptors.h)
+    void initLipinski();
+
+    // Those of a composition, from its parts and the two atoms bonded (0-based).
+    void composeLipinski(const Molecule& mol1, const Molecule& mol2, int thisAtom, int thatAtom);
+
+    // Whether every composition of the two exceeds a Lipinski bound.
     static bool willExceedAdditiveThresholds(const Molecule &mol1, const Molecule &mol2);
     // Constructs a simple version of this molecule consisting of the fragment counts
     // and the fingerprint (fragment graph)
@@ -101,6 +127,27 @@ class Molecule
 
     std::string ConstructSMI() const;
 
+    //
+    // The assembly is the sequence of compositions that produced this molecule:
+    //    varint base fragment, then per new bond: varint atom (in the molecule so far),
+    //    varint fragment, varint atom (in that fragment).
+    // Replaying it against the same fragment library reproduces the molecule.
+    //
+    const std::string& getAssembly() const { return assembly; }
+    void initAssembly();
+
+    // Reconstruct a molecule from its assembly as SMILES (or an SDF block);
+    // false if the assembly does not fit the current base molecules.
+    static bool WriteAssembly(const std::string& assembly, bool asSDF, std::string& out);
+
+    // A new molecule composed as the assembly describes; 0 if the assembly
+    // does not fit the current base molecules or is a single fragment.
+    static Molecule* Reassemble(const std::string& assembly);
+
+    // Identifies the fragment library an assembly refers to.
+    static unsigned LibraryHash();
+    static unsigned LibraryHash(const std::vector<Molecule*>& fragments);
+
     // The 'size' of a molecule is based on the number of total fragments.
     unsigned int size() const;
 
@@ -127,9 +174,11 @@ class Molecule
     void init_openbabel_lock();
     static pthread_mutex_t openbabel_lock;
 
-    void WriteToOpenBabelFormat(std::string&) const;
+    // Coordinates are written as 0 unless given (one per atom).
+    void WriteToOpenBabelFormat(std::string&, const std::vector<Point>* coordinates = 0) const;
 
-    static bool ProbabilisticExclusion(const Molecule* const);
+    static bool ProbabilisticExclusion(const Molecule* const,
+                                       const CounterRng& rng, const std::string& smi);
 
   //
   /////////////////////////////////////////////////////////////////////////
@@ -143,10 +192,19 @@ class Molecule
     // The unique identifier for this molecule
     unsigned int uniqueIndexID;
 
+    // How this molecule was composed from the base molecules
+    std::string assembly;
+
     // Local atoms and bonds
     std::vector<Atom*> atoms;
     std::vector<Bond> bonds;
 
+    // The docked pose of an input fragment (parallels atoms); empty for synthesized molecules
+    std::vector<Point> coordinates;
+
+    // Hydrogen and heavy-atom neighbor counts (parallels atoms)
+    std::vector<AtomState> atomStates;
+
     // Used for molecular comparison; the molecule represented as a graph
     SimpleFragmentGraph* fingerprint;
 
@@ -154,6 +212,10 @@ class Molecule
     // rigid in this molecule
     unsigned short int* fragmentCounter;
 
+    // Totals of the fragment counter, maintained through composition
+    unsigned short int numRigidFragments;
+    unsigned short int numLinkerFragments;
+
     //
     // Lipinski Descriptors
     //
@@ -173,7 +235,7 @@ class Molecule
     //
     // Inline functions
     //
-    virtual void parseAppendix(std::string& comment, int numAtoms = 0)
+    virtual void parseAppendix(const SdfRecord& record, int numAtoms = 0)
     {
         std::cerr << "Called Wrong parseAppendix::MOLECULE" << std::endl;
     }
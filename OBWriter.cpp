@@ -44,21 +44,21 @@
 #include "IdFactory.h"
 #include "Options.h"
 #include "zpipe.h"
+#include "OutputChannel.h"
+#include "Conformer.h"
 
 
 
 // Static Definitions
 pthread_mutex_t OBWriter::valid_molecule_lock;
 pthread_mutex_t OBWriter::sdf_output_file_lock;
-pthread_mutex_t OBWriter::smi_output_file_lock;
 pthread_mutex_t OBWriter::id_lock;
-pthread_mutex_t OBWriter::popen_lock;
 pthread_mutex_t OBWriter::smi_popen_lock;
 pthread_mutex_t OBWriter::writer_popen_lock;
 //IdFactory OBWriter::molIDmaker(1000);
 std::ofstream OBWriter::out;
 std::string OBWriter::outFileName;
-std::vector<OpenBabel::OBMol*> OBWriter::compliantMols;
+FingerprintIndex OBWriter::compliantFingerprints;
 bool OBWriter::synthesis_complete = false;
 bool OBWriter::performValidation = true;
 Thread_Pool<std::string, int>* OBWriter::staticPool = 0;
@@ -71,12 +71,27 @@ OpenBabel::OBConversion OBWriter::SDF_to_SMI_conv;
 OBWriter::OBWriter(unsigned int threadCount) : mCounter(0),
                                                mFailCounter(0),
                                                writing_complete(false),
-                                               writing_started(false)          
+                                               writing_started(false),
+                                               smiChannel(0),
+                                               resumeCount(0)
 {
-    // Create the thread pool
+    // Validation fingerprints are added by the synthesis threads from the start.
+    Initialize();
+
+    //
+    // Create the thread pool; a few molecules are queued per worker so that
+    // synthesis blocks, rather than accumulating molecules, when obgen falls behind.
+    //
     if (!Options::SMI_ONLY)
     {
-        pool = new Thread_Pool<std::string, int>(threadCount, OBWriter::OutputSingleMolecule);
+        // Register the formats and find the obgen worker before the pool threads start.
+        OpenBabel::OBConversion conv;
+        conv.SetInAndOutFormats("SDF", "SDF");
+        OBGen::Initialize();
+
+        pool = new Thread_Pool<std::string, int>(threadCount, OBWriter::OutputSingleMolecule,
+                                                 4 * threadCount);
+        OBWriter::SetPool(pool);
     }
 
     molCounter = 0;
@@ -95,6 +110,8 @@ OBWriter::~OBWriter()
 {
     // Killing the thread pool to force all threads to join.
     if (!Options::SMI_ONLY) delete pool;
+
+    delete smiChannel;
 }
 
 // ****************************************************************************
@@ -103,12 +120,12 @@ void OBWriter::InitializeFile(const std::string& outFile)
 {
     outFileName = outFile;
 
-    /*
+    // Only 3D output (without -smi-only) goes to this file; the pool workers append to it.
+    if (Options::SMI_ONLY) return;
 
     out.open(outFile.c_str());
 
     if (out.fail()) throw "Output stream opening failed.";
-    */
 }
 
 
@@ -117,9 +134,7 @@ void OBWriter::InitializeFile(const std::string& outFile)
 void OBWriter::Initialize()
 {
     pthread_mutex_init(&OBWriter::valid_molecule_lock, NULL);
-    pthread_mutex_init(&OBWriter::smi_output_file_lock, NULL);
     pthread_mutex_init(&OBWriter::sdf_output_file_lock, NULL);
-    pthread_mutex_init(&OBWriter::popen_lock, NULL);
 }
 
 // ****************************************************************************
@@ -138,10 +153,24 @@ void OBWriter::IndicateSynthesisStarted()
         theDir += Options::OUTPUT_DIR_SUFFIX;
     }
 
+    // A resumed run continues in its own directory; its files are kept.
+    if (Options::RESUME_DIR != "") theDir = Options::RESUME_DIR;
+
     std::cout << "Will output to directory: " << theDir << std::endl;
 
+    // The extended run is read as this one writes; it must not be cleaned away.
+    struct stat outputStat;
+    struct stat extendStat;
+    if (Options::EXTEND_DIR != "" &&
+        stat(theDir.c_str(), &outputStat) == 0 && stat(Options::EXTEND_DIR.c_str(), &extendStat) == 0 &&
+        outputStat.st_dev == extendStat.st_dev && outputStat.st_ino == extendStat.st_ino)
+    {
+        std::cerr << "The output directory must differ from the run being extended (-odir)." << std::endl;
+        exit(1);
+    }
+
     bool overwrite = true;
-    if (DoesDirectoryExist(theDir))
+    if (Options::RESUME_DIR == "" && DoesDirectoryExist(theDir))
     {
         std::cout << "The output directory " << theDir << " exists." << std::endl;
         std::cout << "Do you wish to overwrite? (Y / N)" << std::endl; 
@@ -167,12 +196,54 @@ void OBWriter::IndicateSynthesisStarted()
 //exit(1);
 
     // Remove all files in the directory
-    CleanDirectory(theDir);
+    if (Options::RESUME_DIR == "") CleanDirectory(theDir);
 
     // Set specific output file information.
     outputDir = theDir;
     sdfOutfileName = outputDir + "/" + prefix + "-1-10000" + sdfSuffix;
     smiOutfileName = outputDir + "/" + prefix + "-1-250000" + smiSuffix;    
+
+    OutputFormat format;
+    format.compressionThreads = Options::COMPRESSION_THREADS;
+    format.blockRecords = Options::BLOCK_RECORDS;
+    format.properties = Options::PROPERTY_SIDECAR;
+
+    // Checkpoints save the output of the current file from this journal.
+    if (Options::CHECKPOINT)
+    {
+        format.journal = outputDir + "/" + prefix + ".journal";
+        format.resumeCount = resumeCount;
+        format.resumeJournal.swap(resumeJournal);
+    }
+
+    //
+    // Binary output: fragment assemblies in seekable blocks, tied to this fragment library.
+    //
+    if (Options::BINARY_OUTPUT)
+    {
+        if (format.blockRecords == 0) format.blockRecords = BlockFormat::DEFAULT_BLOCK_RECORDS;
+        format.encoding = BlockFormat::ENCODING_ASSEMBLY;
+        format.library = Molecule::LibraryHash();
+        smiSuffix = ".asm";
+    }
+
+    // All SMI output is funneled through a single writer thread.
+    smiChannel = new OutputChannel(outputDir, prefix, smiSuffix, UPPERBOUND, format);
+}
+
+// ****************************************************************************
+
+void OBWriter::ResumeOutput(unsigned long long count, const std::string& journal)
+{
+    resumeCount = count;
+    resumeJournal = journal;
+}
+
+bool OBWriter::SyncOutput(unsigned long long& count, std::string& journal)
+{
+    if (smiChannel == 0) return false;
+
+    return smiChannel->sync(count, journal);
 }
 
 // ****************************************************************************
@@ -181,25 +252,19 @@ void OBWriter::IndicateSynthesisComplete()
 {
     synthesis_complete = true;
 
-    if (Options::SMI_ONLY)
-    {
-        OBWriter::out.close();
+    // Write and compress the remaining SMI molecules.
+    if (smiChannel != 0) smiChannel->close();
 
-        zlib_compress(smiOutfileName, smiOutfileName + ".zlib");
-        remove(smiOutfileName.c_str());
-    }
-    else
+    if (!Options::SMI_ONLY)
     {
         std::cerr << "Synthesis is complete; writing continues." << std::endl;
         std::cerr << "Input pool contains " << pool->in_q_size()
                   << " molecules to process with obgen." << std::endl;
 
-        // Spin until writing is complete.
-        while (writing_started && mCounter > pool->out_q_size())
-        {
-            // Sleep 5 seconds; obgen takes a while.
-            sleep(5);
-        }
+        // Block until every queued molecule has been through obgen.
+        pool->wait_idle();
+        OBWriter::out.flush();
+
         std::cerr << "Writing of the molecules with obgen is complete." << std::endl;
     }
 }
@@ -209,11 +274,7 @@ void OBWriter::IndicateSynthesisComplete()
 void OBWriter::OutputMoleculeInternal(unsigned int non_killed_sz, unsigned int current_sz, Molecule& mol)
 {
     // If this is the first call to output, save the fact we are writing
-    if (!writing_started)
-    {
-        if (!Options::SMI_ONLY) OBWriter::Initialize();
-        writing_started = true;
-    }
+    if (!writing_started) writing_started = true;
 
     //
     // Output molecule
@@ -261,14 +322,15 @@ num_blocked--;
         }
         // output only the SMI version of the information to the output file.
         OBWriter::out << smiMol << std::endl;
+
+        // Maintain a count
+        OBWriter::numCompliant++;
     }
     else
     {
-        pool->push(smiMol);
+        // The workers lay out the 3D conformer and count it (OutputSingleMolecule).
+        OutputMoleculeConformer(mol);
     }
-
-    // Maintain a count
-    OBWriter::numCompliant++;
 }
 
 // ****************************************************************************
@@ -346,44 +408,40 @@ void OBWriter::OutputMoleculeExternalSMI(Molecule& mol)
 
 // ****************************************************************************
 
-void OBWriter::OutputMoleculeAppendExternalSMI(const std::string& smi)
+void OBWriter::OutputMoleculeAppendExternalSMI(const std::string& smi, unsigned level,
+                                               const PropertyRow* properties)
 {
     //
-    // Append an SMI version of the molecule to the output file.
+    // Append an SMI version of the molecule to the output file; the writer
+    // thread handles buffering and file rotation.
     //
-    pthread_mutex_lock(&smi_output_file_lock);
-
-    molCounter++;
-
-    //
-    // Update the file we are writing to.
-    //
-    if (molCounter % UPPERBOUND == 0)
-    {
-        // zip the file we just created and remove it.
-        zlib_compress(smiOutfileName, smiOutfileName + ".zlib");
-        remove(smiOutfileName.c_str());
-
-        //
-        // Create the new output file name.
-        //
-        std::ostringstream oss;
-
-        oss << outputDir << "/" << prefix << "-" << molCounter
-            << "-" << (molCounter + UPPERBOUND) << smiSuffix;
-
-        smiOutfileName = oss.str();
-    }
-
-
-    std::ofstream outfile(smiOutfileName.c_str(),
-                          std::ofstream::out | std::ofstream::app); // append
+    if (properties != 0) smiChannel->write(smi, level, *properties);
+    else smiChannel->write(smi, level);
+}
 
-    outfile << smi << std::endl;
+//
+// 3D output: the pool lays out the conformer from the assembly in a worker.
+// Blocks while the pool's queue is full, so synthesis follows 3D output.
+//
+void OBWriter::OutputMoleculeConformer(const Molecule& mol)
+{
+    pool->submit(mol.getAssembly(), OBWriter::ConformerWritten);
+}
 
-    outfile.close();
+//
+// The status of a written conformer is not kept (the pool's output queue would
+// otherwise hold one entry per molecule); failures are reported by the worker.
+//
+void OBWriter::ConformerWritten(const std::string&, const int&, void*)
+{
+}
 
-    pthread_mutex_unlock(&smi_output_file_lock);
+void OBWriter::OutputMoleculeAppendAssembly(const std::string& assembly, unsigned level,
+                                            const PropertyRow* properties)
+{
+    // Same channel as SMI output; the channel was opened for binary records.
+    if (properties != 0) smiChannel->write(assembly, level, *properties);
+    else smiChannel->write(assembly, level);
 }
 
 // ****************************************************************************
@@ -403,10 +461,10 @@ void OBWriter::IndicateSMIwritingComplete() const
 void OBWriter::OutputMoleculeAppendExternalSDF(Molecule& mol)
 {
     //
-    // Create the SDF format
+    // Create the SDF format; coordinates are laid out from the fragment poses.
     //
     std::string sdf;
-    mol.WriteToOpenBabelFormat(sdf);
+    Conformer::Write(mol, sdf);
    
     //
     // Append an SDF version of the molecule to the output file.
@@ -536,7 +594,7 @@ void OBWriter::OutputMoleculeExternalSDF(Molecule& mol)
 
 // ****************************************************************************
 
-int OBWriter::OutputSingleMolecule(std::string smiMol)
+int OBWriter::OutputSingleMolecule(std::string assembly)
 {
     // Output debugging information / progress bar
     unsigned inPoolSize = OBWriter::InputPoolSize();
@@ -545,70 +603,20 @@ int OBWriter::OutputSingleMolecule(std::string smiMol)
     std::cerr << "Pool IN queue (" << inPoolSize
               << "); OUT queue (" << outPoolSize << ")" << std::endl;
 
-    // 
-    // Write SMI to a temp file
     //
-
-    // (a) create temp file
-    char tmpFileNameBuff[32]; // temp file name
-    int filedes = -1; // file descriptor
-
-    // memset the buffer to 0 (thread-safe)
-    memset(tmpFileNameBuff, 0, sizeof(tmpFileNameBuff));
-
-    // Copy the dir/template the buffer// (thread-safe)
-    std::string shmpath = Options::shmPath;
-    shmpath += "chemTmpFile-XXXXXX.smi";
-    strncpy(tmpFileNameBuff, shmpath.c_str(), shmpath.size());
-
-    // generate unique non existing name from template, afterwards, buffer
-    // contains actual file name(thread-safe)
-    filedes = mkstemps(tmpFileNameBuff, 4);
-    if(filedes < 1)
-    {
-        std::cerr << "Creation of temp file failed" << std::endl;
-        return -1;
-    }
-
-    // (b) write SMI into file
-    FILE *tmp_file; // file pointer
-    tmp_file = fdopen(filedes, "w"); // 'front end' file pointer made from file descriptor
-    fputs(smiMol.c_str(), tmp_file); // write to tmp file (fputs requires file pointer)
-    fclose(tmp_file); // no longer need front end, get rid of it
-
-    //
-    // Call external instance of obgen
+    // Lay out the 3D conformer in this worker thread from the docked fragment
+    // poses and settle it with a short minimization (Conformer::Write); only
+    // molecules whose fragments have no pose are generated from scratch.
     //
-    // (a) set up function call, we suppress all stderr messages with 2> and
-    // keep stdout with output.
-    std::string obgenCall = "./synthobgen " + string(tmpFileNameBuff) + " 2> /dev/null";
-    std::cerr << "Calling: " << obgenCall << std::endl;
-
-    // (b) Spawn obgen process to work on the temp file. resulting SDF in string 'result'
-    pthread_mutex_lock(&popen_lock);
-    FILE* pipe = popen(&obgenCall[0], "r"); // not clear wether is thread safe
-    pthread_mutex_unlock(&popen_lock);
-
-    if (!pipe)
+    std::string result;
+    if (!Molecule::WriteAssembly(assembly, true, result))
     {
-        std::cerr << "Creation of obgen caller pipe failed" << std::endl;
+        std::cerr << "A queued molecule has an invalid assembly." << std::endl;
         return -1;
     }
 
-    char data_buffer[128];
-    std::string result = "";
-    while(!feof(pipe)) {
-    	if(fgets(data_buffer, 128, pipe) != NULL)
-    		result += data_buffer;
-    }
-
-    pthread_mutex_lock(&popen_lock);
-    pclose(pipe); // not clear wether is thread safe
-    pthread_mutex_unlock(&popen_lock);
-
-    // (c) close and unlink temporary file
-    close(filedes);
-    unlink(tmpFileNameBuff); // even if called, file won't actually delete until file is closed
+    // Without a force field the assembled block stands; it lacks the record delimiter.
+    if (result.find("$$$$") == std::string::npos) result += "\n$$$$\n";
 
     //
     // (d) Append output to a total output file.
@@ -617,35 +625,26 @@ int OBWriter::OutputSingleMolecule(std::string smiMol)
     OBWriter::out << result;
     pthread_mutex_unlock(&sdf_output_file_lock);
 
-    //
-    // (e) We keep the SDF version of the synthesized molecule; only for validation purposes
-    //
-    if (OBWriter::performValidation)
-    {
-        // Begin open babel usage
-        pthread_mutex_lock(& Molecule::openbabel_lock);
-
-        // store result into a new molecule
-        OpenBabel::OBMol* mol = new OpenBabel::OBMol();
-        OpenBabel::OBConversion SDF_conv;
-        SDF_conv.SetInAndOutFormats("SDF", "SDF");
-        SDF_conv.ReadString(mol, result);
-
-        // End open babel usage
-        pthread_mutex_unlock(& Molecule::openbabel_lock);
+    // Maintain a count
+    __sync_fetch_and_add(&OBWriter::numCompliant, 1);
 
-        // Save the valid molecule for validation purposes
-        pthread_mutex_lock(& OBWriter::valid_molecule_lock);
-        OBWriter::compliantMols.push_back(mol);
-        pthread_mutex_unlock(& OBWriter::valid_molecule_lock);
-    }
+    return 0;
+}
 
-    // Maintain a count
-    OBWriter::numCompliant++;
+// ****************************************************************************
 
-    std::cerr << tmpFileNameBuff << " completed." << std::endl;
+//
+// We keep the fingerprint of each synthesized molecule; only for validation purposes.
+// Computed from the molecule's own tables, so synthesis threads call this directly.
+//
+void OBWriter::AddValidationMolecule(const Molecule& mol, const std::string& name)
+{
+    unsigned long long fp[Fingerprint::WORDS];
+    Fingerprint::Compute(mol, fp);
 
-    return 0;
+    pthread_mutex_lock(& OBWriter::valid_molecule_lock);
+    OBWriter::compliantFingerprints.add(fp, name);
+    pthread_mutex_unlock(& OBWriter::valid_molecule_lock);
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -799,15 +798,14 @@ std:: cerr << "|" << smiMol << "|" << std::endl;
 
         // Save the valid molecule for validation purposes
         pthread_mutex_lock(& OBWriter::valid_molecule_lock);
-        OBWriter::compliantMols.push_back(mol);
+        OBWriter::compliantFingerprints.add(*mol);
+        delete mol;
         pthread_mutex_unlock(& OBWriter::valid_molecule_lock);
     }
 
     // Maintain a count
     OBWriter::numCompliant++;
 
-    std::cerr << tmpFileNameBuff << " completed." << std::endl;
-
     return 0;
 */
 }
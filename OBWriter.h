@@ -32,6 +32,8 @@
 #include "Molecule.h"
 #include "Thread_Pool.h"
 #include "IdFactory.h"
+#include "OutputChannel.h"
+#include "Fingerprint.h"
 
 
 //
@@ -47,16 +49,31 @@ class OBWriter
     void OutputMoleculeInternal(unsigned int, unsigned int, Molecule&);
     void OutputMoleculeExternalSMI(Molecule&);
     void OutputMoleculeExternalSDF(Molecule&);
-    void OutputMoleculeAppendExternalSMI(const std::string& smi);
+    void OutputMoleculeAppendExternalSMI(const std::string& smi, unsigned level = 0,
+                                         const PropertyRow* properties = 0);
+    void OutputMoleculeAppendAssembly(const std::string& assembly, unsigned level = 0,
+                                      const PropertyRow* properties = 0);
     void OutputMoleculeAppendExternalSDF(Molecule&);
-    static int OutputSingleMolecule(std::string smiMol);
-    static std::vector<OpenBabel::OBMol*> compliantMols;
+    void OutputMoleculeConformer(const Molecule& mol);
+    static int OutputSingleMolecule(std::string assembly);
+    static FingerprintIndex compliantFingerprints;
+
+    // Index a synthesized molecule for validation (-v); safe from synthesis threads.
+    static void AddValidationMolecule(const Molecule& mol, const std::string& name);
 
     void IndicateSynthesisStarted();
     void IndicateSynthesisComplete();
     void InitiateOutputThreadPool();
     void IndicateSMIwritingComplete() const;
 
+    // Continue the output of a checkpointed run; call before IndicateSynthesisStarted.
+    void ResumeOutput(unsigned long long count, const std::string& journal);
+
+    // Wait for queued output; the number of molecules output and the journal of the current file.
+    bool SyncOutput(unsigned long long& count, std::string& journal);
+
+    const std::string& getOutputDir() const { return outputDir; }
+
     static void InitializeFile(const std::string& outFile);
 
     void write(std::vector<Molecule> molecules);
@@ -79,10 +96,8 @@ class OBWriter
 
     static bool synthesis_complete;
     static bool performValidation;
-    static pthread_mutex_t smi_output_file_lock;
     static pthread_mutex_t sdf_output_file_lock;
     static pthread_mutex_t id_lock;
-    static pthread_mutex_t popen_lock;
     static pthread_mutex_t smi_popen_lock;
     static pthread_mutex_t writer_popen_lock;
     static pthread_mutex_t valid_molecule_lock;
@@ -97,8 +112,13 @@ class OBWriter
     // The same static version of the pool.
     static Thread_Pool<std::string, int>* staticPool;
 
+    // Buffered SMI output; created once the output directory is known.
+    OutputChannel* smiChannel;
+
     void Initialize();
 
+    static void ConformerWritten(const std::string& assembly, const int& status, void*);
+
     void ScrubAndExportSMI(std::vector<Molecule>& molecules);
     void CallsBeforeWriting(std::vector<Molecule>& molecules);
 
@@ -111,6 +131,10 @@ class OBWriter
     std::string outputDir;
     std::string sdfOutfileName;
     std::string smiOutfileName;
+
+    // Output already written by a checkpointed run
+    unsigned long long resumeCount;
+    std::string resumeJournal;
 };
 
 #endif
@@ -39,6 +39,22 @@ unsigned Options::OBGEN_THREAD_POOL_SIZE = 15;
 //unsigned Options::SMI_LEVEL_BOUND = 3;
 unsigned Options::PROBABILITY_PRUNE_LEVEL_START = 5;
 std::string Options::OUTPUT_DIR_SUFFIX = "";
+unsigned long long Options::SEED = 0;
+unsigned Options::COMPRESSION_THREADS = 0;
+unsigned Options::BLOCK_RECORDS = 0;
+unsigned Options::LOAD_THREADS = 0;
+unsigned Options::VALIDATE_THREADS = 0;
+bool Options::BINARY_OUTPUT = false;
+bool Options::TARGET_DIRECTED = false;
+bool Options::PROPERTY_SIDECAR = false;
+bool Options::DECODE_SDF = false;
+bool Options::CHECKPOINT = false;
+unsigned Options::CHECKPOINT_MINUTES = 0;
+std::string Options::RESUME_DIR = "";
+std::string Options::EXTEND_DIR = "";
+unsigned long long Options::MEMORY_BUDGET = 0;
+std::string Options::SPILL_DIR = "";
+unsigned Options::SPILL_THRESHOLD = 100000;
 
 Options::Options(int argCount, char** vals) : argc(argCount), argv(vals)
 {
@@ -46,6 +62,9 @@ Options::Options(int argCount, char** vals) : argc(argCount), argv(vals)
     outFile = "molecules.sdf";
     outFileSMI = "molecules.smi";
     validationFile = "";
+    targetsFile = "";
+    decodeFile = "";
+    libraryFile = "";
 
     Options::TANIMOTO = 0.95;
     Options::THREADED = false;
@@ -134,6 +153,16 @@ bool Options::handleOption(int& index)
         validationFile = argv[++index];
         return true;
     }
+    if (strcmp(argv[index], "-targets") == 0)
+    {
+        targetsFile = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-target-directed") == 0)
+    {
+        TARGET_DIRECTED = true;
+        return true;
+    }
     if (strncmp(argv[index], "-tc", 3) == 0)
     {
         // not directly following; e.g. -tc 0.95
@@ -207,6 +236,114 @@ bool Options::handleOption(int& index)
             PROBABILITY_PRUNE_LEVEL_START = atoi(&argv[index][11]);
         return true;
     }
+    if (strncmp(argv[index], "-seed", 5) == 0)
+    {
+        if (strcmp(argv[index], "-seed") == 0)
+            SEED = strtoull(argv[++index], NULL, 10);
+        else
+            SEED = strtoull(&argv[index][5], NULL, 10);
+        return true;
+    }
+    if (strncmp(argv[index], "-zthreads", 9) == 0)
+    {
+        if (strcmp(argv[index], "-zthreads") == 0)
+            COMPRESSION_THREADS = atoi(argv[++index]);
+        else
+            COMPRESSION_THREADS = atoi(&argv[index][9]);
+        return true;
+    }
+    if (strncmp(argv[index], "-block", 6) == 0)
+    {
+        if (strcmp(argv[index], "-block") == 0)
+            BLOCK_RECORDS = atoi(argv[++index]);
+        else
+            BLOCK_RECORDS = atoi(&argv[index][6]);
+        return true;
+    }
+    if (strncmp(argv[index], "-load-threads", 13) == 0)
+    {
+        if (strcmp(argv[index], "-load-threads") == 0)
+            LOAD_THREADS = atoi(argv[++index]);
+        else
+            LOAD_THREADS = atoi(&argv[index][13]);
+        return true;
+    }
+    if (strncmp(argv[index], "-validate-threads", 17) == 0)
+    {
+        if (strcmp(argv[index], "-validate-threads") == 0)
+            VALIDATE_THREADS = atoi(argv[++index]);
+        else
+            VALIDATE_THREADS = atoi(&argv[index][17]);
+        return true;
+    }
+    if (strcmp(argv[index], "-binary") == 0)
+    {
+        BINARY_OUTPUT = true;
+        return true;
+    }
+    if (strcmp(argv[index], "-props") == 0)
+    {
+        PROPERTY_SIDECAR = true;
+        return true;
+    }
+    if (strcmp(argv[index], "-checkpoint") == 0)
+    {
+        CHECKPOINT = true;
+        CHECKPOINT_MINUTES = atoi(argv[++index]);
+        return true;
+    }
+    if (strcmp(argv[index], "-resume") == 0)
+    {
+        CHECKPOINT = true;
+        RESUME_DIR = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-mem-budget") == 0)
+    {
+        // Megabytes, or with a suffix: e.g. 512M, 48G
+        char* suffix = 0;
+        MEMORY_BUDGET = strtoull(argv[++index], &suffix, 10);
+
+        if (*suffix == 'G' || *suffix == 'g') MEMORY_BUDGET <<= 30;
+        else MEMORY_BUDGET <<= 20;
+        return true;
+    }
+    if (strcmp(argv[index], "-spill") == 0)
+    {
+        SPILL_DIR = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-spill-after") == 0)
+    {
+        SPILL_THRESHOLD = atoi(argv[++index]);
+        return true;
+    }
+    if (strcmp(argv[index], "-extend") == 0)
+    {
+        EXTEND_DIR = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-add") == 0)
+    {
+        addFiles.push_back(argv[++index]);
+        return true;
+    }
+    if (strcmp(argv[index], "-lib") == 0)
+    {
+        libraryFile = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-decode") == 0)
+    {
+        decodeFile = argv[++index];
+        return true;
+    }
+    if (strcmp(argv[index], "-decode-sdf") == 0)
+    {
+        DECODE_SDF = true;
+        decodeFile = argv[++index];
+        return true;
+    }
     if (strncmp(argv[index], "-smi-only", 9) == 0)
     {
         Options::SMI_ONLY = true;
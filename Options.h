@@ -37,7 +37,11 @@ class Options
     std::string outFile;
     std::string outFileSMI;
     std::string validationFile;
+    std::string targetsFile;
+    std::string decodeFile;
+    std::string libraryFile;
     std::vector<std::string> inFiles;
+    std::vector<std::string> addFiles;
 
     static double TANIMOTO;
     static bool THREADED;
@@ -49,6 +53,22 @@ class Options
     static unsigned int OBGEN_THREAD_POOL_SIZE;
     static bool SMI_ONLY;
     static std::string OUTPUT_DIR_SUFFIX;
+    static unsigned long long SEED;
+    static unsigned COMPRESSION_THREADS;
+    static unsigned BLOCK_RECORDS;
+    static unsigned LOAD_THREADS;
+    static unsigned VALIDATE_THREADS;
+    static bool BINARY_OUTPUT;
+    static bool TARGET_DIRECTED;
+    static bool PROPERTY_SIDECAR;
+    static bool DECODE_SDF;
+    static bool CHECKPOINT;
+    static unsigned CHECKPOINT_MINUTES;
+    static std::string RESUME_DIR;
+    static std::string EXTEND_DIR;
+    static unsigned long long MEMORY_BUDGET;
+    static std::string SPILL_DIR;
+    static unsigned SPILL_THRESHOLD;
 
   private:
     int argc;
@@ -0,0 +1,774 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <pthread.h>
+
+
+#include "OutputChannel.h"
+#include "zpipe.h"
+
+
+OutputChannel::OutputChannel(const std::string& dir, const std::string& pre,
+                             const std::string& suf, unsigned upperBound,
+                             const OutputFormat& format) : head(&stub),
+                                                           tail(&stub),
+                                                           queuedBytes(0),
+                                                           waiting(0),
+                                                           sleeping(0),
+                                                           closed(false),
+                                                           started(false),
+                                                           outputDir(dir),
+                                                           prefix(pre),
+                                                           suffix(suf),
+                                                           UPPERBOUND(upperBound),
+                                                           molCounter(0),
+                                                           stream(0),
+                                                           compressors(0),
+                                                           maxInFlight(2 * format.compressionThreads),
+                                                           file(0),
+                                                           fileOffset(0),
+                                                           blockRecords(format.blockRecords),
+                                                           encoding(format.encoding),
+                                                           library(format.library),
+                                                           properties(0),
+                                                           journalName(format.journal),
+                                                           journal(0)
+{
+    pthread_mutex_init(&wake_lock, NULL);
+    pthread_cond_init(&wake, NULL);
+    pthread_mutex_init(&chunk_lock, NULL);
+    pthread_cond_init(&chunk_done, NULL);
+    pthread_mutex_init(&sync_lock, NULL);
+    pthread_cond_init(&synced, NULL);
+    pthread_mutex_init(&room_lock, NULL);
+    pthread_cond_init(&room, NULL);
+
+    if (format.properties) properties = new PropertySidecar;
+
+    if (format.compressionThreads > 0)
+    {
+        compressors = new Thread_Pool<Chunk*, Chunk*>(format.compressionThreads,
+                                                      OutputChannel::CompressChunk);
+    }
+
+    // Binary records have no delimiter; they are only written in blocks.
+    if (blockRecords == 0) encoding = BlockFormat::ENCODING_TEXT;
+
+    if (blockRecords > 0) extension = BlockFormat::SUFFIX;
+    else if (compressors != 0) extension = ".gz";
+    else extension = ".zlib";
+
+    block.count = 0;
+
+    buffer.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+
+    std::ostringstream oss;
+    oss << outputDir << "/" << prefix << "-1-" << UPPERBOUND << suffix;
+    fileName = oss.str();
+
+    if (format.resumeCount > 0) restore(format.resumeCount, format.resumeJournal);
+    else openFile();
+
+    if (pthread_create(&writer, NULL, OutputChannel::writer_func, this) == 0)
+    {
+        started = true;
+    }
+    else
+    {
+        std::cerr << "Output writer thread creation failed." << std::endl;
+    }
+}
+
+OutputChannel::~OutputChannel()
+{
+    close();
+
+    delete compressors;
+    delete properties;
+
+    pthread_cond_destroy(&room);
+    pthread_mutex_destroy(&room_lock);
+    pthread_cond_destroy(&synced);
+    pthread_mutex_destroy(&sync_lock);
+    pthread_cond_destroy(&chunk_done);
+    pthread_mutex_destroy(&chunk_lock);
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&wake_lock);
+}
+
+// ****************************************************************************
+
+void OutputChannel::write(const std::string& record, unsigned level)
+{
+    push(new Node(record, level));
+}
+
+void OutputChannel::write(const std::string& record, unsigned level, const PropertyRow& row)
+{
+    Node* node = new Node(record, level);
+    node->row = row;
+
+    push(node);
+}
+
+void OutputChannel::push(Node* node)
+{
+    // Counted before the node is visible, so the writer never subtracts first.
+    unsigned long long queued = __sync_add_and_fetch(&queuedBytes, Size(node));
+
+    enqueue(node);
+
+    signal();
+
+    if (queued <= HIGH_WATER) return;
+
+    //
+    // Wait for the writer to drain the queue; it wakes us below LOW_WATER.
+    // Announcing the wait (a full barrier) before reading the count pairs with
+    // the writer reading 'waiting' after its decrement, so no wakeup is missed.
+    //
+    pthread_mutex_lock(&room_lock);
+
+    __sync_add_and_fetch(&waiting, 1);
+    while (queuedBytes > LOW_WATER && !closed)
+    {
+        pthread_cond_wait(&room, &room_lock);
+    }
+    __sync_sub_and_fetch(&waiting, 1);
+
+    pthread_mutex_unlock(&room_lock);
+}
+
+void OutputChannel::signal()
+{
+    // Wake the writer only if it has gone to sleep.
+    __sync_synchronize();
+    if (sleeping)
+    {
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&wake_lock);
+    }
+}
+
+void OutputChannel::close()
+{
+    if (closed) return;
+
+    pthread_mutex_lock(&wake_lock);
+    closed = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&wake_lock);
+
+    // No producer waits on a closed channel.
+    pthread_mutex_lock(&room_lock);
+    pthread_cond_broadcast(&room);
+    pthread_mutex_unlock(&room_lock);
+
+    if (started)
+    {
+        (void) pthread_join(writer, NULL);
+    }
+    // Without a writer thread, drain here.
+    else
+    {
+        run();
+    }
+}
+
+bool OutputChannel::sync(unsigned long long& count, std::string& saved)
+{
+    if (!started || closed) return false;
+
+    SyncPoint point;
+    point.done = false;
+    point.count = 0;
+
+    Node* node = new Node();
+    node->sync = &point;
+
+    enqueue(node);
+
+    signal();
+
+    pthread_mutex_lock(&sync_lock);
+    while (!point.done)
+    {
+        pthread_cond_wait(&synced, &sync_lock);
+    }
+    pthread_mutex_unlock(&sync_lock);
+
+    count = point.count;
+    saved.swap(point.journal);
+
+    return true;
+}
+
+// ****************************************************************************
+
+void OutputChannel::enqueue(Node* node)
+{
+    node->next = 0;
+
+    // Publish the node's contents before the node itself.
+    __sync_synchronize();
+    Node* prev = __sync_lock_test_and_set(&head, node);
+    prev->next = node;
+}
+
+//
+// Consumer side only; returns 0 if the queue is empty or a producer is
+// between exchanging the head and linking its node (it will signal afterward).
+//
+OutputChannel::Node* OutputChannel::dequeue()
+{
+    Node* t = tail;
+    Node* next = t->next;
+
+    if (t == &stub)
+    {
+        if (next == 0) return 0;
+
+        tail = next;
+        t = next;
+        next = next->next;
+    }
+
+    if (next != 0)
+    {
+        tail = next;
+        return t;
+    }
+
+    if (t != head) return 0;
+
+    // t is the last node; put the stub behind it so t can be released.
+    enqueue(&stub);
+
+    next = t->next;
+    if (next != 0)
+    {
+        tail = next;
+        return t;
+    }
+
+    return 0;
+}
+
+// ****************************************************************************
+
+void* OutputChannel::writer_func(void* This)
+{
+    static_cast<OutputChannel*>(This)->run();
+
+    return 0;
+}
+
+void OutputChannel::run()
+{
+    while (true)
+    {
+        Node* node = 0;
+
+        while ((node = dequeue()) != 0)
+        {
+            consume(node);
+        }
+
+        //
+        // Nothing to write; advertise that we are going to sleep, then re-check
+        // before waiting so that a concurrent write cannot be missed.
+        //
+        pthread_mutex_lock(&wake_lock);
+
+        sleeping = 1;
+        __sync_synchronize();
+
+        node = dequeue();
+        while (node == 0 && !closed)
+        {
+            pthread_cond_wait(&wake, &wake_lock);
+            node = dequeue();
+        }
+
+        sleeping = 0;
+
+        pthread_mutex_unlock(&wake_lock);
+
+        // Closed and drained.
+        if (node == 0) break;
+
+        consume(node);
+    }
+
+    closeFile();
+
+    // The output is complete; the journal is no longer needed.
+    if (journal != 0)
+    {
+        fclose(journal);
+        journal = 0;
+        remove(journalName.c_str());
+    }
+}
+
+void OutputChannel::consume(Node* node)
+{
+    if (node->sync == 0)
+    {
+        unsigned long long size = Size(node);
+
+        append(*node);
+        delete node;
+
+        unsigned long long queued = __sync_sub_and_fetch(&queuedBytes, size);
+        if (waiting > 0 && queued <= LOW_WATER)
+        {
+            pthread_mutex_lock(&room_lock);
+            pthread_cond_broadcast(&room);
+            pthread_mutex_unlock(&room_lock);
+        }
+
+        return;
+    }
+
+    //
+    // A sync point: every record queued before it has been appended.
+    //
+    SyncPoint* point = node->sync;
+    delete node;
+
+    point->count = molCounter;
+
+    if (journal != 0)
+    {
+        fflush(journal);
+
+        FILE* in = fopen(journalName.c_str(), "rb");
+        if (in != 0)
+        {
+            char bytes[1 << 16];
+            size_t n;
+            while ((n = fread(bytes, 1, sizeof(bytes), in)) > 0)
+            {
+                point->journal.append(bytes, n);
+            }
+
+            fclose(in);
+        }
+    }
+
+    pthread_mutex_lock(&sync_lock);
+    point->done = true;
+    pthread_cond_broadcast(&synced);
+    pthread_mutex_unlock(&sync_lock);
+}
+
+// ****************************************************************************
+
+void OutputChannel::append(const Node& node)
+{
+    const std::string& record = node.record;
+    unsigned level = node.level;
+
+    molCounter++;
+
+    //
+    // Update the file we are writing to.
+    //
+    if (molCounter % UPPERBOUND == 0)
+    {
+        // Finish the compressed file we just created.
+        closeFile();
+
+        //
+        // Create the new output file name.
+        //
+        std::ostringstream oss;
+
+        oss << outputDir << "/" << prefix << "-" << molCounter
+            << "-" << (molCounter + UPPERBOUND) << suffix;
+
+        fileName = oss.str();
+
+        openFile();
+    }
+
+    //
+    // Track the extent of the current block
+    //
+    if (block.count == 0)
+    {
+        block.firstId = molCounter;
+        block.minLevel = level;
+        block.maxLevel = level;
+    }
+    else
+    {
+        if (level < block.minLevel) block.minLevel = level;
+        if (level > block.maxLevel) block.maxLevel = level;
+    }
+    block.count++;
+
+    if (properties != 0) properties->add(node.row);
+
+    if (journal != 0) writeJournal(node);
+
+    if (encoding == BlockFormat::ENCODING_ASSEMBLY)
+    {
+        PutVarint(buffer, record.size());
+        buffer += record;
+    }
+    else
+    {
+        buffer += record;
+        buffer += '\n';
+    }
+
+    if (blockRecords > 0)
+    {
+        if (block.count >= blockRecords) flush();
+    }
+    else if (buffer.size() >= BUFFER_SIZE) flush();
+}
+
+void OutputChannel::flush()
+{
+    // The properties of the records about to be written form one sidecar block.
+    if (properties != 0) properties->flush(block.firstId);
+
+    //
+    // Chunked output: hand the buffer to the compression pool (or compress it
+    // here), then write whatever has completed.
+    //
+    if (compressors != 0 || blockRecords > 0)
+    {
+        if (buffer.empty() || file == 0) return;
+
+        Chunk* chunk = new Chunk;
+        chunk->input.swap(buffer);
+        chunk->ret = 0;
+        chunk->done = false;
+        chunk->gzip = blockRecords == 0;
+        chunk->entry = block;
+        chunk->entry.rawSize = chunk->input.size();
+
+        block.count = 0;
+        buffer.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+
+        inFlight.push_back(chunk);
+
+        if (compressors != 0)
+        {
+            compressors->submit(chunk, OutputChannel::ChunkCompressed, this);
+        }
+        else
+        {
+            CompressChunk(chunk);
+            chunk->done = true;
+        }
+
+        retire(maxInFlight);
+
+        return;
+    }
+
+    block.count = 0;
+
+    if (buffer.empty() || stream == 0) return;
+
+    if (!zlib_stream_write(stream, buffer.data(), buffer.size()))
+    {
+        std::cerr << "Write to " << fileName << extension << " failed." << std::endl;
+    }
+
+    buffer.clear();
+}
+
+void OutputChannel::openFile()
+{
+    if (properties != 0) properties->open(fileName + PropertyFormat::SUFFIX);
+
+    // The journal holds only the records of the current file.
+    if (!journalName.empty())
+    {
+        if (journal != 0) fclose(journal);
+
+        journal = fopen(journalName.c_str(), "wb");
+        if (journal == 0)
+        {
+            std::cerr << "Journal " << journalName << " could not be opened." << std::endl;
+        }
+    }
+
+    if (compressors != 0 || blockRecords > 0)
+    {
+        file = fopen((fileName + extension).c_str(), "wb");
+        fileOffset = 0;
+        index.clear();
+
+        if (file == 0)
+        {
+            std::cerr << "Output file " << fileName << extension << " could not be opened." << std::endl;
+            return;
+        }
+
+        if (blockRecords > 0)
+        {
+            std::string header(BlockFormat::HEADER_MAGIC, sizeof(BlockFormat::HEADER_MAGIC));
+            PutU32(header, BlockFormat::VERSION);
+            PutU32(header, encoding);
+            PutU32(header, blockRecords);
+            PutU32(header, library);
+
+            writeFileBytes(header);
+        }
+
+        return;
+    }
+
+    stream = zlib_stream_open(fileName + extension);
+
+    if (stream == 0)
+    {
+        std::cerr << "Output file " << fileName << extension << " could not be opened." << std::endl;
+    }
+}
+
+void OutputChannel::closeFile()
+{
+    if (compressors != 0 || blockRecords > 0)
+    {
+        if (file == 0) return;
+
+        flush();
+        retire(0);
+
+        //
+        // Seekable blocks: the index of blocks, then the trailer locating it.
+        //
+        if (blockRecords > 0)
+        {
+            unsigned long long indexOffset = fileOffset;
+
+            std::string footer;
+            for (unsigned b = 0; b < index.size(); b++)
+            {
+                EncodeIndexEntry(footer, index[b]);
+            }
+
+            PutU64(footer, indexOffset);
+            PutU32(footer, index.size());
+            PutU32(footer, BlockFormat::VERSION);
+            footer.append(BlockFormat::TRAILER_MAGIC, sizeof(BlockFormat::TRAILER_MAGIC));
+
+            writeFileBytes(footer);
+        }
+
+        fclose(file);
+        file = 0;
+
+        if (properties != 0) properties->close();
+
+        return;
+    }
+
+    if (stream == 0) return;
+
+    flush();
+
+    if (properties != 0) properties->close();
+
+    if (!zlib_stream_close(stream))
+    {
+        std::cerr << "Completing " << fileName << extension << " failed." << std::endl;
+    }
+
+    stream = 0;
+}
+
+void OutputChannel::writeFileBytes(const std::string& bytes)
+{
+    if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size())
+    {
+        std::cerr << "Write to " << fileName << extension << " failed." << std::endl;
+    }
+
+    fileOffset += bytes.size();
+}
+
+// ****************************************************************************
+
+//
+// Journal records: varint level, varint length, the record, then the
+// property row (float per column) when the sidecar is written.
+//
+void OutputChannel::writeJournal(const Node& node)
+{
+    std::string bytes;
+    PutVarint(bytes, node.level);
+    PutVarint(bytes, node.record.size());
+    bytes += node.record;
+
+    if (properties != 0)
+    {
+        for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+        {
+            PutF32(bytes, node.row.value[c]);
+        }
+    }
+
+    if (fwrite(bytes.data(), 1, bytes.size(), journal) != bytes.size())
+    {
+        std::cerr << "Write to " << journalName << " failed." << std::endl;
+    }
+}
+
+bool OutputChannel::readJournal(const unsigned char*& in, const unsigned char* end, Node& node) const
+{
+    unsigned length;
+    if (!GetVarint(in, end, node.level) || !GetVarint(in, end, length) ||
+        length > (unsigned)(end - in))
+    {
+        return false;
+    }
+
+    node.record.assign((const char*)in, length);
+    in += length;
+
+    if (properties != 0)
+    {
+        if ((unsigned)(end - in) < 4 * PropertyFormat::NUM_COLUMNS) return false;
+
+        for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++, in += 4)
+        {
+            node.row.value[c] = GetF32(in);
+        }
+    }
+
+    return true;
+}
+
+//
+// The saved journal holds the records of the file that 'count' ends in; the
+// files before it are complete. Rewriting those records recreates that file
+// (and its sidecar) exactly as an uninterrupted run would have it.
+//
+void OutputChannel::restore(unsigned long long count, const std::string& saved)
+{
+    const unsigned char* begin = (const unsigned char*)saved.data();
+    const unsigned char* end = begin + saved.size();
+
+    unsigned long long numRecords = 0;
+    Node node;
+    for (const unsigned char* in = begin; in < end; numRecords++)
+    {
+        if (!readJournal(in, end, node))
+        {
+            numRecords = 0;
+            break;
+        }
+    }
+
+    unsigned long long first = count - numRecords + 1;
+
+    if (numRecords == 0 || numRecords > count || (first != 1 && first % UPPERBOUND != 0))
+    {
+        std::cerr << "The output journal does not match the checkpoint; output restarts." << std::endl;
+        openFile();
+        return;
+    }
+
+    //
+    // The first file is opened here; a later file is opened (after closing
+    // nothing) as its first record rotates the output.
+    //
+    molCounter = first - 1;
+    if (first == 1) openFile();
+
+    for (const unsigned char* in = begin; in < end; )
+    {
+        readJournal(in, end, node);
+        append(node);
+    }
+}
+
+// ****************************************************************************
+
+//
+// Compression worker: each chunk becomes a complete gzip member or zlib block.
+//
+OutputChannel::Chunk* OutputChannel::CompressChunk(Chunk* chunk)
+{
+    chunk->ret = def_buffer(chunk->input.data(), chunk->input.size(), chunk->output, -1, chunk->gzip);
+
+    // The input is no longer needed; release it before the chunk is written.
+    std::string().swap(chunk->input);
+
+    return chunk;
+}
+
+void OutputChannel::ChunkCompressed(Chunk* const& in, Chunk* const&, void* This_void)
+{
+    OutputChannel* This = static_cast<OutputChannel*>(This_void);
+
+    pthread_mutex_lock(&This->chunk_lock);
+    in->done = true;
+    pthread_cond_broadcast(&This->chunk_done);
+    pthread_mutex_unlock(&This->chunk_lock);
+}
+
+void OutputChannel::retire(unsigned keep)
+{
+    while (!inFlight.empty())
+    {
+        Chunk* chunk = inFlight.front();
+
+        pthread_mutex_lock(&chunk_lock);
+        while (!chunk->done && inFlight.size() > keep)
+        {
+            pthread_cond_wait(&chunk_done, &chunk_lock);
+        }
+        bool done = chunk->done;
+        pthread_mutex_unlock(&chunk_lock);
+
+        // The oldest chunk is still being compressed and we may keep it in flight.
+        if (!done) break;
+
+        if (chunk->ret != 0)
+        {
+            std::cerr << "Compression for " << fileName << extension << " failed." << std::endl;
+        }
+        else
+        {
+            if (blockRecords > 0)
+            {
+                chunk->entry.offset = fileOffset;
+                chunk->entry.size = chunk->output.size();
+                index.push_back(chunk->entry);
+            }
+
+            writeFileBytes(chunk->output);
+        }
+
+        inFlight.pop_front();
+        delete chunk;
+    }
+}
@@ -0,0 +1,261 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OUTPUT_CHANNEL_GUARD
+#define _OUTPUT_CHANNEL_GUARD 1
+
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <cstdio>
+#include <pthread.h>
+
+
+#include "zpipe.h"
+#include "Thread_Pool.h"
+#include "BlockFormat.h"
+#include "PropertySidecar.h"
+
+
+//
+// A persistent, buffered output stream of molecules (one record per line).
+//
+// Any number of synthesis threads hand records to a lock-free queue; a single
+// writer thread owns the output file, accumulates records in a large buffer,
+// and rotates the file every 'upperBound' records. Producers never touch the
+// file system. Records are deflated as they are written, so only the
+// compressed (.zlib) files ever reach the disk.
+//
+// Once HIGH_WATER bytes are queued, producers wait until the writer has
+// drained the queue below LOW_WATER, so synthesis follows the disk.
+//
+// With compression threads, each full buffer is instead compressed as an
+// independent gzip member by a pool of workers (.gz files); the writer thread
+// appends the members in order and bounds the number of buffers in flight.
+//
+// With a block size, output is the seekable container of BlockFormat.h (.blk
+// files): each block of that many molecules is an independent zlib stream,
+// compressed inline or by the pool, and an index of the blocks is appended
+// when the file is rotated. Records in blocks are either text lines or
+// length-prefixed binary (fragment assemblies).
+//
+// With properties, a columnar sidecar (PropertyFormat.h) is written beside
+// each file, one block of properties per block (or buffer) of records.
+//
+// With a journal, the records of the current file are also kept uncompressed
+// in the journal file. A checkpoint saves the journal (see sync); a channel
+// resumed from it rewrites the current file exactly as it was and continues.
+//
+struct OutputFormat
+{
+    unsigned compressionThreads;  // 0: compress on the writer thread
+    unsigned blockRecords;        // 0: not seekable
+    unsigned encoding;            // BlockFormat::ENCODING_*; blocks only
+    unsigned library;             // Fragment library hash recorded in block files
+    bool properties;              // Write the property sidecar
+    std::string journal;          // Journal file name; empty for none
+
+    // Resume after this many records, given the journal saved with them.
+    unsigned long long resumeCount;
+    std::string resumeJournal;
+
+    OutputFormat() : compressionThreads(0),
+                     blockRecords(0),
+                     encoding(BlockFormat::ENCODING_TEXT),
+                     library(0),
+                     properties(false),
+                     resumeCount(0) {}
+};
+
+class OutputChannel
+{
+  public:
+    OutputChannel(const std::string& dir, const std::string& prefix,
+                  const std::string& suffix, unsigned upperBound,
+                  const OutputFormat& format = OutputFormat());
+    ~OutputChannel();
+
+    // Queue a record for output; blocks only while the queue is over HIGH_WATER.
+    // The level is kept in the block index.
+    void write(const std::string& record, unsigned level = 0);
+
+    // As above, with the molecule's properties for the sidecar.
+    void write(const std::string& record, unsigned level, const PropertyRow& row);
+
+    // Write all queued records, compress the final file, and stop the writer.
+    void close();
+
+    //
+    // Block until every record queued before the call has been written; then
+    // the number of records output and the journal of the current file.
+    //
+    bool sync(unsigned long long& count, std::string& journal);
+
+  private:
+    //
+    // Multi-producer / single-consumer intrusive queue: producers exchange the
+    // head pointer; the consumer follows 'next' links from the tail. A stub
+    // node keeps the queue non-empty so producers never contend with the consumer.
+    //
+    struct SyncPoint
+    {
+        bool done;
+        unsigned long long count;
+        std::string journal;
+    };
+
+    struct Node
+    {
+        Node* volatile next;
+        std::string record;
+        unsigned level;
+        PropertyRow row;
+
+        // Not a record: the writer completes the sync point instead.
+        SyncPoint* sync;
+
+        Node() : next(0), level(0), row(), sync(0) {}
+        Node(const std::string& r, unsigned l) : next(0), record(r), level(l), row(), sync(0) {}
+    };
+
+    Node* volatile head;  // most recently pushed; written by producers
+    Node* tail;           // next to consume; owned by the writer thread
+    Node stub;
+
+    void enqueue(Node* node);
+    Node* dequeue();
+
+    //
+    // Backpressure: bytes queued (records and nodes), and producers waiting for room.
+    //
+    static const unsigned long long HIGH_WATER = 64ULL << 20;
+    static const unsigned long long LOW_WATER = 32ULL << 20;
+
+    volatile unsigned long long queuedBytes;
+    volatile int waiting;
+    pthread_mutex_t room_lock;
+    pthread_cond_t room;
+
+    // Account for a record about to be queued; and wait for room once queued.
+    static unsigned long long Size(const Node* node) { return sizeof(Node) + node->record.size(); }
+    void push(Node* node);
+
+    // The writer sleeps on 'wake' only after advertising it with 'sleeping'.
+    volatile int sleeping;
+    volatile bool closed;
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+
+    pthread_t writer;
+    bool started;
+
+    static void* writer_func(void* This);
+    void run();
+    void consume(Node* node);
+
+    pthread_mutex_t sync_lock;
+    pthread_cond_t synced;
+
+    //
+    // State owned by the writer thread
+    //
+    std::string outputDir;
+    std::string prefix;
+    std::string suffix;
+    unsigned UPPERBOUND;
+
+    unsigned molCounter;
+    std::string fileName;
+    std::string extension;
+    zlib_stream* stream;
+
+    // Records are accumulated and compressed in large blocks.
+    static const unsigned BUFFER_SIZE = 1 << 20;
+    std::string buffer;
+
+    void append(const Node& node);
+    void signal();
+    void flush();
+    void openFile();
+    void closeFile();
+
+    //
+    // Parallel compression
+    //
+    struct Chunk
+    {
+        std::string input;
+        std::string output;
+        int ret;
+        bool done;
+        bool gzip;
+
+        // Index information (seekable blocks)
+        BlockIndexEntry entry;
+    };
+
+    Thread_Pool<Chunk*, Chunk*>* compressors;
+
+    // Submitted chunks, in output order; at most maxInFlight are retained.
+    std::deque<Chunk*> inFlight;
+    unsigned maxInFlight;
+
+    pthread_mutex_t chunk_lock;
+    pthread_cond_t chunk_done;
+
+    // Output file for the concatenated gzip members or blocks
+    FILE* file;
+    unsigned long long fileOffset;
+
+    //
+    // Seekable blocks: molecules per block (0 when not seekable), the
+    // block being filled, and the index of the blocks written to this file.
+    //
+    unsigned blockRecords;
+    unsigned encoding;
+    unsigned library;
+    BlockIndexEntry block;
+    std::vector<BlockIndexEntry> index;
+
+    // Property sidecar for the current file; 0 if not written.
+    PropertySidecar* properties;
+
+    // Journal of the records in the current file; 0 if not kept.
+    std::string journalName;
+    FILE* journal;
+
+    void writeJournal(const Node& node);
+    bool readJournal(const unsigned char*& in, const unsigned char* end, Node& node) const;
+
+    // Recreate the current file from a saved journal.
+    void restore(unsigned long long count, const std::string& saved);
+
+    void writeFileBytes(const std::string& bytes);
+
+    static Chunk* CompressChunk(Chunk* chunk);
+    static void ChunkCompressed(Chunk* const& in, Chunk* const& out, void* This);
+
+    // Write completed chunks in order, waiting until at most 'keep' remain in flight.
+    void retire(unsigned keep);
+
+    // Not copyable.
+    OutputChannel(const OutputChannel&);
+    OutputChannel& operator=(const OutputChannel&);
+};
+
+#endif
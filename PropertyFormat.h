@@ -0,0 +1,131 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROPERTY_FORMAT_GUARD
+#define _PROPERTY_FORMAT_GUARD 1
+
+
+#include <string>
+#include <cstring>
+
+
+#include "BlockFormat.h"
+
+
+//
+// The columnar property sidecar (.props) written beside each output file.
+//
+//    Header   : magic[8] "ESYNPRP1", version u32, number of columns u32
+//    Blocks   : per block of molecules, each column stored contiguously
+//               (fixed width; see COLUMN_WIDTH), uncompressed
+//    Index    : one entry per block (PropertyIndexEntry) with the
+//               min / max of every column in the block
+//    Trailer  : index offset u64, number of blocks u32, version u32,
+//               magic[8] "ESYNPIX1"
+//
+// Blocks cover the same molecule ids as the blocks of the output file, so a
+// query can skip whole blocks using the index and read only the columns it
+// needs without touching the molecules themselves.
+//
+namespace PropertyFormat
+{
+    static const char HEADER_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'P', 'R', 'P', '1' };
+    static const char TRAILER_MAGIC[8] = { 'E', 'S', 'Y', 'N', 'P', 'I', 'X', '1' };
+
+    static const unsigned VERSION = 1;
+
+    enum Column
+    {
+        MOL_WT,
+        HBD,
+        HBA1,
+        LOGP,
+        LINKERS,
+        RIGIDS,
+        NUM_COLUMNS
+    };
+
+    // float32 descriptors; u16 fragment counts
+    static const unsigned COLUMN_WIDTH[NUM_COLUMNS] = { 4, 4, 4, 4, 2, 2 };
+    static const char* const COLUMN_NAME[NUM_COLUMNS] = { "MolWt", "HBD", "HBA1", "logP",
+                                                          "Linkers", "Rigids" };
+
+    static const unsigned HEADER_SIZE = 16;
+    static const unsigned INDEX_ENTRY_SIZE = 24 + 8 * NUM_COLUMNS;
+    static const unsigned TRAILER_SIZE = 24;
+
+    static const char* const SUFFIX = ".props";
+}
+
+// The properties of a single molecule, in column order.
+struct PropertyRow
+{
+    float value[PropertyFormat::NUM_COLUMNS];
+};
+
+struct PropertyIndexEntry
+{
+    unsigned long long firstId;  // Id of the first molecule in the block (as in the output file)
+    unsigned long long offset;   // Byte offset of the block in the sidecar
+    unsigned count;              // Number of molecules in the block
+    float min[PropertyFormat::NUM_COLUMNS];
+    float max[PropertyFormat::NUM_COLUMNS];
+};
+
+inline void PutF32(std::string& out, float v)
+{
+    unsigned bits;
+    memcpy(&bits, &v, sizeof(bits));
+    PutU32(out, bits);
+}
+
+inline float GetF32(const unsigned char* in)
+{
+    unsigned bits = GetU32(in);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline void EncodePropertyIndexEntry(std::string& out, const PropertyIndexEntry& entry)
+{
+    PutU64(out, entry.firstId);
+    PutU64(out, entry.offset);
+    PutU32(out, entry.count);
+    PutU32(out, 0);
+
+    for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+    {
+        PutF32(out, entry.min[c]);
+        PutF32(out, entry.max[c]);
+    }
+}
+
+inline void DecodePropertyIndexEntry(const unsigned char* in, PropertyIndexEntry& entry)
+{
+    entry.firstId = GetU64(in);
+    entry.offset = GetU64(in + 8);
+    entry.count = GetU32(in + 16);
+
+    for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+    {
+        entry.min[c] = GetF32(in + 24 + 8 * c);
+        entry.max[c] = GetF32(in + 28 + 8 * c);
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "PropertyReader.h"
+
+
+PropertyReader::PropertyReader() : data(0), size(0)
+{
+}
+
+PropertyReader::~PropertyReader()
+{
+    close();
+}
+
+bool PropertyReader::open(const std::string& name)
+{
+    close();
+
+    fileName = name;
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Property file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    struct stat buffer;
+    if (fstat(fd, &buffer) != 0 ||
+        buffer.st_size < PropertyFormat::HEADER_SIZE + PropertyFormat::TRAILER_SIZE)
+    {
+        std::cerr << "Property file " << fileName << " is too short." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size = buffer.st_size;
+
+    void* mapped = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Property file " << fileName << " could not be mapped." << std::endl;
+        size = 0;
+        return false;
+    }
+
+    data = static_cast<const unsigned char*>(mapped);
+
+    //
+    // Verify the header and trailer
+    //
+    const unsigned char* trailer = data + size - PropertyFormat::TRAILER_SIZE;
+
+    if (memcmp(data, PropertyFormat::HEADER_MAGIC, sizeof(PropertyFormat::HEADER_MAGIC)) != 0 ||
+        memcmp(trailer + 16, PropertyFormat::TRAILER_MAGIC, sizeof(PropertyFormat::TRAILER_MAGIC)) != 0)
+    {
+        std::cerr << "Property file " << fileName << " is incomplete or not a property file." << std::endl;
+        close();
+        return false;
+    }
+
+    if (GetU32(data + 8) != PropertyFormat::VERSION ||
+        GetU32(data + 12) != PropertyFormat::NUM_COLUMNS)
+    {
+        std::cerr << "Property file " << fileName << " has an unsupported layout." << std::endl;
+        close();
+        return false;
+    }
+
+    //
+    // Acquire the index
+    //
+    unsigned long long indexOffset = GetU64(trailer);
+    unsigned count = GetU32(trailer + 8);
+
+    if (indexOffset + (unsigned long long)count * PropertyFormat::INDEX_ENTRY_SIZE !=
+        size - PropertyFormat::TRAILER_SIZE)
+    {
+        std::cerr << "Property file " << fileName << " has a corrupt index." << std::endl;
+        close();
+        return false;
+    }
+
+    index.resize(count);
+    for (unsigned b = 0; b < count; b++)
+    {
+        DecodePropertyIndexEntry(data + indexOffset + b * PropertyFormat::INDEX_ENTRY_SIZE, index[b]);
+    }
+
+    return true;
+}
+
+void PropertyReader::close()
+{
+    if (data != 0) munmap(const_cast<unsigned char*>(data), size);
+
+    data = 0;
+    size = 0;
+    index.clear();
+}
+
+//
+// Columns are stored one after another within the block.
+//
+float PropertyReader::value(unsigned b, int column, unsigned i) const
+{
+    const PropertyIndexEntry& entry = index[b];
+
+    const unsigned char* in = data + entry.offset;
+    for (int c = 0; c < column; c++)
+    {
+        in += entry.count * PropertyFormat::COLUMN_WIDTH[c];
+    }
+
+    in += i * PropertyFormat::COLUMN_WIDTH[column];
+
+    if (PropertyFormat::COLUMN_WIDTH[column] == 4) return GetF32(in);
+
+    return in[0] | (in[1] << 8);
+}
@@ -0,0 +1,69 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROPERTY_READER_GUARD
+#define _PROPERTY_READER_GUARD 1
+
+
+#include <string>
+#include <vector>
+
+
+#include "PropertyFormat.h"
+
+
+//
+// Read access to a columnar property sidecar (see PropertyFormat.h).
+//
+// The file is memory-mapped; values are read in place, so a query touches
+// only the index and the columns of blocks it cannot rule out.
+//
+class PropertyReader
+{
+  public:
+    PropertyReader();
+    ~PropertyReader();
+
+    // Map the file and load its index; false (with a message) if it is not a valid sidecar.
+    bool open(const std::string& fileName);
+    void close();
+
+    unsigned numBlocks() const { return index.size(); }
+    const PropertyIndexEntry& block(unsigned b) const { return index[b]; }
+
+    // Could any molecule in block b have lo <= column <= hi?
+    bool mayContain(unsigned b, int column, float lo, float hi) const
+    {
+        return index[b].max[column] >= lo && index[b].min[column] <= hi;
+    }
+
+    // The value of a column for the i-th molecule of block b.
+    float value(unsigned b, int column, unsigned i) const;
+
+  private:
+    std::string fileName;
+    const unsigned char* data;
+    unsigned long long size;
+
+    std::vector<PropertyIndexEntry> index;
+
+    // Not copyable.
+    PropertyReader(const PropertyReader&);
+    PropertyReader& operator=(const PropertyReader&);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+
+#include "PropertySidecar.h"
+
+
+PropertySidecar::PropertySidecar() : file(0), fileOffset(0)
+{
+}
+
+PropertySidecar::~PropertySidecar()
+{
+    close();
+}
+
+bool PropertySidecar::open(const std::string& name)
+{
+    close();
+
+    fileName = name;
+    fileOffset = 0;
+    rows.clear();
+    index.clear();
+
+    file = fopen(fileName.c_str(), "wb");
+    if (file == 0)
+    {
+        std::cerr << "Property file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    std::string header(PropertyFormat::HEADER_MAGIC, sizeof(PropertyFormat::HEADER_MAGIC));
+    PutU32(header, PropertyFormat::VERSION);
+    PutU32(header, PropertyFormat::NUM_COLUMNS);
+
+    writeBytes(header);
+
+    return true;
+}
+
+void PropertySidecar::add(const PropertyRow& row)
+{
+    rows.push_back(row);
+}
+
+void PropertySidecar::flush(unsigned long long firstId)
+{
+    if (rows.empty()) return;
+
+    if (file == 0)
+    {
+        rows.clear();
+        return;
+    }
+
+    PropertyIndexEntry entry;
+    entry.firstId = firstId;
+    entry.offset = fileOffset;
+    entry.count = rows.size();
+
+    std::string bytes;
+    bytes.reserve(rows.size() * sizeof(PropertyRow));
+
+    //
+    // Each column contiguously, tracking its extent in this block
+    //
+    for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+    {
+        entry.min[c] = rows[0].value[c];
+        entry.max[c] = rows[0].value[c];
+
+        for (unsigned r = 0; r < rows.size(); r++)
+        {
+            float v = rows[r].value[c];
+
+            if (v < entry.min[c]) entry.min[c] = v;
+            if (v > entry.max[c]) entry.max[c] = v;
+
+            if (PropertyFormat::COLUMN_WIDTH[c] == 4) PutF32(bytes, v);
+            else
+            {
+                unsigned short count = (unsigned short)v;
+                bytes += (char)(count & 0xFF);
+                bytes += (char)(count >> 8);
+            }
+        }
+    }
+
+    writeBytes(bytes);
+
+    index.push_back(entry);
+    rows.clear();
+}
+
+void PropertySidecar::close()
+{
+    if (file == 0) return;
+
+    if (!rows.empty())
+    {
+        std::cerr << "Property file " << fileName << " closed with an unwritten block." << std::endl;
+        rows.clear();
+    }
+
+    unsigned long long indexOffset = fileOffset;
+
+    std::string footer;
+    for (unsigned b = 0; b < index.size(); b++)
+    {
+        EncodePropertyIndexEntry(footer, index[b]);
+    }
+
+    PutU64(footer, indexOffset);
+    PutU32(footer, index.size());
+    PutU32(footer, PropertyFormat::VERSION);
+    footer.append(PropertyFormat::TRAILER_MAGIC, sizeof(PropertyFormat::TRAILER_MAGIC));
+
+    writeBytes(footer);
+
+    fclose(file);
+    file = 0;
+}
+
+void PropertySidecar::writeBytes(const std::string& bytes)
+{
+    if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size())
+    {
+        std::cerr << "Write to " << fileName << " failed." << std::endl;
+    }
+
+    fileOffset += bytes.size();
+}
@@ -0,0 +1,66 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROPERTY_SIDECAR_GUARD
+#define _PROPERTY_SIDECAR_GUARD 1
+
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+#include "PropertyFormat.h"
+
+
+//
+// Writes the columnar property sidecar (see PropertyFormat.h) for one output
+// file; owned by the writer thread of an OutputChannel.
+//
+class PropertySidecar
+{
+  public:
+    PropertySidecar();
+    ~PropertySidecar();
+
+    bool open(const std::string& fileName);
+
+    // Add the properties of the next molecule to the current block.
+    void add(const PropertyRow& row);
+
+    // Write the current block; its first molecule has the given id.
+    void flush(unsigned long long firstId);
+
+    // Write the remaining block, the index, and the trailer.
+    void close();
+
+  private:
+    std::string fileName;
+    FILE* file;
+    unsigned long long fileOffset;
+
+    std::vector<PropertyRow> rows;
+    std::vector<PropertyIndexEntry> index;
+
+    void writeBytes(const std::string& bytes);
+
+    // Not copyable.
+    PropertySidecar(const PropertySidecar&);
+    PropertySidecar& operator=(const PropertySidecar&);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+  #include <malloc.h>
+#endif
+
+
+#include "QueueController.h"
+
+
+const double QueueController::LOW_WATER = 0.6;
+const double QueueController::HIGH_WATER = 0.85;
+
+QueueController::QueueController(const unsigned* levelDefaults,
+                                 unsigned numLevels,
+                                 unsigned long long memoryBudget) : defaults(levelDefaults, levelDefaults + numLevels),
+                                                                    limits(levelDefaults, levelDefaults + numLevels),
+                                                                    budget(memoryBudget),
+                                                                    scale(1),
+                                                                    calls(0),
+                                                                    hold(0),
+                                                                    lowStreak(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+QueueController::~QueueController()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+bool QueueController::admits(unsigned level, unsigned queued)
+{
+    sample();
+
+    return limits[level] == 0 || queued < limits[level];
+}
+
+// ****************************************************************************
+
+bool QueueController::sample()
+{
+    if (budget == 0) return false;
+
+    if (__sync_add_and_fetch(&calls, 1) % SAMPLE_INTERVAL != 0) return false;
+
+    if (pthread_mutex_trylock(&lock) != 0) return false;
+
+    unsigned long long used = AllocatedBytes();
+    double previous = scale;
+
+    if (hold > 0) hold--;
+
+    if (used > HIGH_WATER * budget)
+    {
+        lowStreak = 0;
+
+        // Give the queues time to drain to the last limits before halving again.
+        if (hold == 0 && scale > 1.0 / MAX_SCALE)
+        {
+            scale /= 2;
+            hold = HOLD_SAMPLES;
+        }
+    }
+    else if (used < LOW_WATER * budget)
+    {
+        if (++lowStreak >= GROW_SAMPLES && scale < MAX_SCALE)
+        {
+            scale *= 2;
+            lowStreak = 0;
+        }
+    }
+    else lowStreak = 0;
+
+    bool changed = scale != previous;
+    if (changed)
+    {
+        applyScale();
+
+        std::cerr << "Memory in use " << (used >> 20) << " MB of "
+                  << (budget >> 20) << " MB; queue limits scaled by " << scale << std::endl;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return changed;
+}
+
+void QueueController::applyScale()
+{
+    for (unsigned m = 0; m < defaults.size(); m++)
+    {
+        if (defaults[m] == 0) continue;
+
+        unsigned scaled = (unsigned)(defaults[m] * scale);
+        limits[m] = scaled == 0 ? 1 : scaled;
+    }
+}
+
+// ****************************************************************************
+
+//
+// The second field of /proc/self/statm is the resident size in pages.
+//
+unsigned long long QueueController::ResidentBytes()
+{
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return 0;
+
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    int read = fscanf(statm, "%llu %llu", &size, &resident);
+    fclose(statm);
+
+    if (read != 2) return 0;
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+//
+// The allocator's in-use bytes over all arenas (mallinfo2, glibc 2.33 and later).
+//
+unsigned long long QueueController::AllocatedBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+
+    return (unsigned long long)info.uordblks + info.hblkhd;
+#else
+    return ResidentBytes();
+#endif
+}
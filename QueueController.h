@@ -0,0 +1,96 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QUEUE_CONTROLLER_GUARD
+#define _QUEUE_CONTROLLER_GUARD 1
+
+
+#include <vector>
+#include <pthread.h>
+
+
+//
+// Admission limits for the level queues.
+//
+// Without a memory budget the limits are the fixed defaults (MAX_QUEUE_SIZES).
+// With a budget, the memory in use (queues, filters, hypergraph, and all else)
+// is sampled periodically and every default is scaled: halved when near or over
+// the budget, doubled once it has stayed well under. A limit of 0 is limitless
+// and is never scaled.
+//
+// Memory in use is the allocator's count of bytes handed out, not the resident
+// size: freed memory the allocator keeps would otherwise hold the limits down
+// after the queues drain. After a halving the queues are given HOLD_SAMPLES to
+// drain before another, and growth needs GROW_SAMPLES low samples in a row.
+//
+class QueueController
+{
+  public:
+    QueueController(const unsigned* defaults, unsigned numLevels, unsigned long long budget);
+    ~QueueController();
+
+    // The number of molecules that may wait at the level; 0 for limitless.
+    unsigned limit(unsigned level) const { return limits[level]; }
+
+    // May another molecule be queued at the level, given those queued now?
+    bool admits(unsigned level, unsigned queued);
+
+    // Sample memory (every SAMPLE_INTERVAL calls); true if the limits changed.
+    // Safe to call from any thread; a sample in progress elsewhere is not waited on.
+    bool sample();
+
+    // Resident size of this process in bytes; 0 if unavailable.
+    static unsigned long long ResidentBytes();
+
+    // Bytes allocated and not yet freed; the resident size where the allocator cannot tell.
+    static unsigned long long AllocatedBytes();
+
+  private:
+    static const unsigned SAMPLE_INTERVAL = 1024;
+
+    // Scale changes by a factor of 2 within [1 / MAX_SCALE, MAX_SCALE].
+    static const unsigned MAX_SCALE = 64;
+
+    // Fractions of the budget: grow below LOW_WATER, shrink above HIGH_WATER.
+    static const double LOW_WATER;
+    static const double HIGH_WATER;
+
+    // Hysteresis, in samples (see above).
+    static const unsigned HOLD_SAMPLES = 4;
+    static const unsigned GROW_SAMPLES = 4;
+
+    std::vector<unsigned> defaults;
+    std::vector<unsigned> limits;
+
+    unsigned long long budget;
+    double scale;
+
+    unsigned calls;
+    pthread_mutex_t lock;
+
+    // Samples left before another halving; consecutive samples under LOW_WATER.
+    unsigned hold;
+    unsigned lowStreak;
+
+    void applyScale();
+
+    // Not copyable.
+    QueueController(const QueueController&);
+    QueueController& operator=(const QueueController&);
+};
+
+#endif
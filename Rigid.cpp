@@ -19,7 +19,7 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <sstream>
+#include <iostream>
 #include <cctype>
 
 
@@ -28,58 +28,47 @@
 #include "RigidConnectableAtom.h"
 
 
-Rigid::Rigid(OpenBabel::OBMol* obmol, const std::string& name) : Molecule(obmol, name)
+Rigid::Rigid(OpenBabel::OBMol* obmol, const std::string& name,
+             const SdfRecord& record) : Molecule(obmol, name)
 {
-    //
-    // Acquire the comment data, make a copy, parse that comment.
-    //
-    OpenBabel::OBCommentData* comment =
-                           static_cast<OpenBabel::OBCommentData*>(obmol->GetData("Comment"));
-
-    std::string commentStr = comment->GetData();
+    // The appendix is parsed in place from the input file.
+    parseAppendix(record, obmol->NumAtoms());
 
-    parseAppendix(commentStr, obmol->NumAtoms());
+    // Lipinski descriptors by atom contribution; OpenBabel is not consulted.
+    initLipinski();
 
     // if (Options::OPENBABEL) OBWriter::ScrubAndConvertToSMIInternal(obmol, this->smi); 
 }
 
-void Rigid::parseAppendix(std::string& suffix, int numAtoms)
+//
+// The first data item lists the atom types; the second lists, per line, an
+// atom number and the atom types that atom may connect to.
+//
+void Rigid::parseAppendix(const SdfRecord& record, int numAtoms)
 {
-    // Use a string stream instead of manipulatiing the string
-    std::stringstream suffStream(suffix);
-
-    //
-    // Read until we get "> <"
-    //
-    std::string line = "";
-    while(line.find("> <") == std::string::npos)
-    {
-        getline(suffStream, line);
-    }
+    TextView item;
 
     //
     // Read the Atom Types into a temporary
     //
-    std::string atomType;
     std::vector<std::string> atomTypes;
-    for(int x = 0; x < numAtoms; x++)
-    {
-        suffStream >> atomType;
 
-std::cerr << atomType << std::endl;
+    if (record.dataItem(0, item))
+    {
+        TextCursor cursor(item);
+        TextView atomType;
 
-        atomTypes.push_back(atomType);
+        for (int x = 0; x < numAtoms && cursor.nextToken(atomType); x++)
+        {
+            atomTypes.push_back(atomType.str());
+        }
     }
 
-    // Get the next line.
-    getline(suffStream, line);
-
-    //
-    // Read until we get "> <"
-    //
-    while(line.find("> <") == std::string::npos)
+    if (atomTypes.size() != numAtoms)
     {
-        getline(suffStream, line);
+        std::cerr << "Rigid: expected " << numAtoms << " atom types; found "
+                  << atomTypes.size() << std::endl;
+        atomTypes.resize(numAtoms);
     }
 
     //
@@ -89,30 +78,24 @@ std::cerr << atomType << std::endl;
     // Parallels the atom arrays
     std::vector<std::string>* conns = new std::vector<std::string>[atomTypes.size()];    
 
-    int atomId = -1;
-    while (!isspace(suffStream.peek()))    
+    if (record.dataItem(1, item))
     {
-        suffStream >> atomId;
+        TextCursor lines(item);
+        TextView line;
 
-        while (suffStream.peek() != '\n' && suffStream.peek() != '\r')
+        while (lines.nextLine(line))
         {
-            suffStream >> atomType;
+            TextCursor cursor(line);
 
-            conns[atomId - 1].push_back(atomType);
+            int atomId;
+            if (!cursor.nextInt(atomId) || atomId < 1 || atomId > numAtoms) continue;
 
-            eatWhiteToNewLineOrChar(suffStream);
+            TextView atomType;
+            while (cursor.nextToken(atomType))
+            {
+                conns[atomId - 1].push_back(atomType.str());
+            }
         }
-
-        // Get the newline
-        suffStream.get();
-    }
-
-    //
-    // Read through the $$$$
-    //
-    while(line.find("$$$$") == std::string::npos)
-    {
-        getline(suffStream, line);
     }
 
     //
@@ -28,7 +28,7 @@
 class Rigid : public Molecule
 {
   public:
-    Rigid(OpenBabel::OBMol* obmol, const std::string& name);
+    Rigid(OpenBabel::OBMol* obmol, const std::string& name, const SdfRecord& record);
     Rigid() {}
     ~Rigid() {}
 
@@ -42,7 +42,7 @@ class Rigid : public Molecule
     }
 
   protected:  
-    virtual void parseAppendix(std::string& suffix, int numAtoms = -1);
+    virtual void parseAppendix(const SdfRecord& record, int numAtoms = -1);
 };
 
 #endif
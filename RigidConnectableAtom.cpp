@@ -68,6 +68,25 @@ RigidConnectableAtom::RigidConnectableAtom(const std::string& aType, const Rigid
 
 /**********************************************************************************/
 
+RigidConnectableAtom::RigidConnectableAtom(const AtomT& aType, const Rigid* const owner,
+                                           const std::vector<AtomT>& connTypes)
+{
+    this->atomType = aType;
+    this->ownerFragment = (Molecule*)owner;
+    this->theAtom.maxConnect = 1;
+    this->theAtom.numExternalConnections = 0;
+    this->theAtom.numAllowConns = connTypes.size();
+
+    this->allowableTypes = new AtomT*[this->theAtom.numAllowConns];
+
+    for (int a = 0; a < connTypes.size(); a++)
+    {
+        this->allowableTypes[a] = new AtomT(connTypes[a]);
+    }
+}
+
+/**********************************************************************************/
+
 RigidConnectableAtom::~RigidConnectableAtom()
 {
     for (int a = 0; a < this->theAtom.numAllowConns; a++)
@@ -42,6 +42,7 @@ class RigidConnectableAtom : public ConnectableAtom
 
     RigidConnectableAtom(const RigidConnectableAtom* const that);
     RigidConnectableAtom(const std::string&, const Rigid* const owner, const std::vector<std::string>& types);
+    RigidConnectableAtom(const AtomT&, const Rigid* const owner, const std::vector<AtomT>& types);
     ~RigidConnectableAtom();
 
     bool IsLinkerAtom() const { return false; }
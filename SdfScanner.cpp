@@ -0,0 +1,191 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "SdfScanner.h"
+
+
+bool SdfRecord::dataItem(unsigned n, TextView& body) const
+{
+    TextCursor cursor(appendix);
+    TextView line;
+
+    //
+    // Find the n-th header
+    //
+    unsigned item = 0;
+    bool found = false;
+    while (!found && cursor.nextLine(line))
+    {
+        found = line.startsWith("> <") && item++ == n;
+    }
+
+    if (!found) return false;
+
+    //
+    // The body ends at the first blank line (or the end of the molecule).
+    //
+    const char* start = cursor.position();
+    const char* stop = start;
+    while (cursor.nextLine(line) && !line.blank() && !line.startsWith("$$$$"))
+    {
+        stop = line.end;
+    }
+
+    body = TextView(start, stop);
+
+    return true;
+}
+
+// ****************************************************************************
+
+SdfScanner::SdfScanner() : data(0), size(0), current(0)
+{
+}
+
+SdfScanner::~SdfScanner()
+{
+    close();
+}
+
+bool SdfScanner::open(const std::string& fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "SDF file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    struct stat buffer;
+    if (fstat(fd, &buffer) != 0)
+    {
+        std::cerr << "SDF file " << fileName << " could not be read." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size = buffer.st_size;
+
+    // An empty file has no molecules.
+    if (size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "SDF file " << fileName << " could not be mapped." << std::endl;
+        size = 0;
+        return false;
+    }
+
+    // The file is read front to back once.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    data = static_cast<const char*>(mapped);
+    current = data;
+
+    return true;
+}
+
+void SdfScanner::close()
+{
+    if (data != 0) munmap(const_cast<char*>(data), size);
+
+    data = 0;
+    size = 0;
+    current = 0;
+}
+
+bool SdfScanner::next(SdfRecord& record)
+{
+    if (data == 0) return false;
+
+    TextCursor cursor(TextView(current, data + size));
+    TextView line;
+
+    record.name = TextView();
+
+    //
+    // Skip blank lines; a '#' line names the molecule.
+    //
+    const char* start;
+    while (true)
+    {
+        start = cursor.position();
+
+        if (!cursor.nextLine(line))
+        {
+            current = data + size;
+            return false;
+        }
+
+        if (line.blank()) continue;
+
+        if (line.begin[0] == '#' && record.name.empty())
+        {
+            record.name = line;
+            continue;
+        }
+
+        break;
+    }
+
+    //
+    // The molblock runs through the "END" line.
+    //
+    while (!line.contains("END"))
+    {
+        if (!cursor.nextLine(line))
+        {
+            current = data + size;
+            return false;
+        }
+    }
+
+    record.molblock = TextView(start, cursor.position());
+
+    //
+    // The appendix runs through the "$$$$" line.
+    //
+    start = cursor.position();
+    while (cursor.nextLine(line) && !line.contains("$$$$"))
+    {
+    }
+
+    record.appendix = TextView(start, cursor.position());
+
+    current = cursor.position();
+
+    return true;
+}
@@ -0,0 +1,165 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SDF_SCANNER_GUARD
+#define _SDF_SCANNER_GUARD 1
+
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+
+//
+// A range of characters within a mapped file; never owns the text.
+//
+struct TextView
+{
+    const char* begin;
+    const char* end;
+
+    TextView() : begin(0), end(0) {}
+    TextView(const char* b, const char* e) : begin(b), end(e) {}
+
+    bool empty() const { return begin == end; }
+    unsigned size() const { return end - begin; }
+    std::string str() const { return std::string(begin, end); }
+
+    bool startsWith(const char* prefix) const
+    {
+        unsigned length = strlen(prefix);
+        return size() >= length && memcmp(begin, prefix, length) == 0;
+    }
+
+    bool contains(const char* text) const
+    {
+        return std::search(begin, end, text, text + strlen(text)) != end;
+    }
+
+    bool blank() const
+    {
+        for (const char* c = begin; c < end; c++)
+        {
+            if (!isspace(*c)) return false;
+        }
+        return true;
+    }
+};
+
+//
+// Reads whitespace-separated tokens and lines from a TextView.
+//
+class TextCursor
+{
+  public:
+    TextCursor(const TextView& text) : current(text.begin), end(text.end) {}
+
+    bool atEnd() const { return current >= end; }
+    const char* position() const { return current; }
+
+    // The rest of the current line (without the line terminator); advances past it.
+    bool nextLine(TextView& line)
+    {
+        if (atEnd()) return false;
+
+        const char* start = current;
+        const char* newline = static_cast<const char*>(memchr(current, '\n', end - current));
+        const char* stop = newline == 0 ? end : newline;
+
+        current = newline == 0 ? end : newline + 1;
+
+        if (stop > start && stop[-1] == '\r') stop--;
+        line = TextView(start, stop);
+
+        return true;
+    }
+
+    // The next token, skipping any whitespace (including newlines).
+    bool nextToken(TextView& token)
+    {
+        while (current < end && isspace(*current)) current++;
+        if (atEnd()) return false;
+
+        const char* start = current;
+        while (current < end && !isspace(*current)) current++;
+
+        token = TextView(start, current);
+
+        return true;
+    }
+
+    bool nextInt(int& value)
+    {
+        TextView token;
+        if (!nextToken(token)) return false;
+
+        char* stop;
+        value = strtol(token.begin, &stop, 10);
+
+        return stop == token.end;
+    }
+
+  private:
+    const char* current;
+    const char* end;
+};
+
+//
+// A single molecule of an SDF file:
+//    name     : the optional '#' line preceding the molecule
+//    molblock : the header, counts, atom, and bond blocks through "M  END"
+//    appendix : the data items ("> <...>") through "$$$$"
+//
+struct SdfRecord
+{
+    TextView name;
+    TextView molblock;
+    TextView appendix;
+
+    // The body of the n-th data item: the lines after its "> <" header up to the blank line.
+    bool dataItem(unsigned n, TextView& body) const;
+};
+
+//
+// Memory-maps an SDF file and hands out its molecules as views into the mapping;
+// the views are valid until the scanner is closed.
+//
+class SdfScanner
+{
+  public:
+    SdfScanner();
+    ~SdfScanner();
+
+    bool open(const std::string& fileName);
+    void close();
+
+    // The next molecule; false at the end of the file.
+    bool next(SdfRecord& record);
+
+  private:
+    const char* data;
+    unsigned long long size;
+    const char* current;
+
+    // Not copyable.
+    SdfScanner(const SdfScanner&);
+    SdfScanner& operator=(const SdfScanner&);
+};
+
+#endif
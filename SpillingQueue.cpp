@@ -0,0 +1,410 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+
+#include "SpillingQueue.h"
+#include "Molecule.h"
+#include "BlockFormat.h"
+
+
+SpillingQueue::SpillingQueue(unsigned cap) : capacity(cap),
+                                             closed(false),
+                                             threshold(0),
+                                             spilled(0),
+                                             nextSegment(0),
+                                             writeCount(0),
+                                             loading(false),
+                                             prefetching(false),
+                                             stopping(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&not_empty, NULL);
+    pthread_cond_init(&not_full, NULL);
+    pthread_cond_init(&loaded, NULL);
+    pthread_cond_init(&prefetch_wanted, NULL);
+}
+
+SpillingQueue::~SpillingQueue()
+{
+    if (prefetching)
+    {
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_broadcast(&prefetch_wanted);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(prefetcher, NULL);
+    }
+
+    // Segments never read
+    for (unsigned s = 0; s < segments.size(); s++)
+    {
+        unlink(segments[s].first.c_str());
+    }
+
+    pthread_cond_destroy(&prefetch_wanted);
+    pthread_cond_destroy(&loaded);
+    pthread_cond_destroy(&not_full);
+    pthread_cond_destroy(&not_empty);
+    pthread_mutex_destroy(&lock);
+}
+
+void SpillingQueue::enable_spill(const std::string& segmentPrefix, unsigned memoryThreshold)
+{
+    pthread_mutex_lock(&lock);
+
+    prefix = segmentPrefix;
+    threshold = memoryThreshold;
+
+    pthread_mutex_unlock(&lock);
+}
+
+// ****************************************************************************
+
+bool SpillingQueue::push(Molecule* const& mol)
+{
+    pthread_mutex_lock(&lock);
+
+    while (!closed && full())
+    {
+        pthread_cond_wait(&not_full, &lock);
+    }
+
+    if (closed)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    //
+    // Once spilling, every molecule follows those spilled until they have been read back.
+    //
+    if (spilling())
+    {
+        const std::string& assembly = mol->getAssembly();
+
+        PutVarint(writeBuffer, assembly.size());
+        writeBuffer += assembly;
+        writeCount++;
+        spilled++;
+
+        delete mol;
+
+        if (writeBuffer.size() >= SEGMENT_BYTES) flushSegment();
+    }
+    else items.push_back(mol);
+
+    pthread_cond_signal(&not_empty);
+    pthread_mutex_unlock(&lock);
+
+    return true;
+}
+
+//
+// With the lock held; the producer writes its full buffer to the next segment.
+//
+void SpillingQueue::flushSegment()
+{
+    std::ostringstream name;
+    name << prefix << "-" << nextSegment++ << ".spill";
+
+    FILE* file = fopen(name.str().c_str(), "wb");
+    if (file == NULL ||
+        fwrite(writeBuffer.data(), 1, writeBuffer.size(), file) != writeBuffer.size() ||
+        fclose(file) != 0)
+    {
+        std::cerr << "Spilling the level queue to " << name.str() << " failed; exiting." << std::endl;
+        exit(1);
+    }
+
+    segments.push_back(std::make_pair(name.str(), writeCount));
+
+    writeBuffer.clear();
+    writeCount = 0;
+
+    //
+    // The prefetch thread starts with the first segment.
+    //
+    if (!prefetching)
+    {
+        prefetching = pthread_create(&prefetcher, NULL, PrefetchThread, this) == 0;
+    }
+
+    pthread_cond_signal(&prefetch_wanted);
+}
+
+// ****************************************************************************
+
+bool SpillingQueue::pop(Molecule*& mol)
+{
+    pthread_mutex_lock(&lock);
+
+    while (items.empty() && !(spilled > 0 && refill()))
+    {
+        // Closed and drained.
+        if (closed)
+        {
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+
+        pthread_cond_wait(&not_empty, &lock);
+    }
+
+    bool taken = take(mol);
+
+    pthread_mutex_unlock(&lock);
+
+    return taken;
+}
+
+bool SpillingQueue::try_pop(Molecule*& mol)
+{
+    pthread_mutex_lock(&lock);
+
+    if (items.empty() && !(spilled > 0 && refill()))
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    bool taken = take(mol);
+
+    pthread_mutex_unlock(&lock);
+
+    return taken;
+}
+
+//
+// With the lock held and a molecule in memory.
+//
+bool SpillingQueue::take(Molecule*& mol)
+{
+    if (items.empty()) return false;
+
+    mol = items.front();
+    items.pop_front();
+
+    pthread_cond_signal(&not_full);
+
+    // Read ahead before the molecules in memory run out.
+    if (!segments.empty() && items.size() < threshold / 2) pthread_cond_signal(&prefetch_wanted);
+
+    return true;
+}
+
+//
+// With the lock held: nothing is in memory, but molecules were spilled. Wait for
+// a segment being read; otherwise read the next segment, or take the write buffer.
+//
+bool SpillingQueue::refill()
+{
+    while (loading)
+    {
+        pthread_cond_wait(&loaded, &lock);
+    }
+
+    if (!items.empty()) return true;
+
+    if (!segments.empty())
+    {
+        std::pair<std::string, unsigned> segment = segments.front();
+        segments.pop_front();
+        loading = true;
+
+        std::deque<Molecule*> mols;
+        pthread_mutex_unlock(&lock);
+        bool read = ReadSegment(segment.first, mols);
+        pthread_mutex_lock(&lock);
+
+        if (!read) exit(1);
+
+        items.insert(items.end(), mols.begin(), mols.end());
+        spilled -= segment.second;
+        loading = false;
+        pthread_cond_broadcast(&loaded);
+
+        return !items.empty();
+    }
+
+    if (writeCount > 0)
+    {
+        if (!Decode(writeBuffer, items)) exit(1);
+
+        spilled -= writeCount;
+        writeBuffer.clear();
+        writeCount = 0;
+
+        return !items.empty();
+    }
+
+    return false;
+}
+
+// ****************************************************************************
+
+void* SpillingQueue::PrefetchThread(void* queue)
+{
+    static_cast<SpillingQueue*>(queue)->prefetch();
+
+    return 0;
+}
+
+//
+// Read the next segment while the molecules in memory fall below half the threshold.
+//
+void SpillingQueue::prefetch()
+{
+    pthread_mutex_lock(&lock);
+
+    while (true)
+    {
+        while (!stopping && (segments.empty() || loading || items.size() >= threshold / 2))
+        {
+            pthread_cond_wait(&prefetch_wanted, &lock);
+        }
+
+        if (stopping) break;
+
+        std::pair<std::string, unsigned> segment = segments.front();
+        segments.pop_front();
+        loading = true;
+
+        std::deque<Molecule*> mols;
+        pthread_mutex_unlock(&lock);
+        bool read = ReadSegment(segment.first, mols);
+        pthread_mutex_lock(&lock);
+
+        if (!read) exit(1);
+
+        items.insert(items.end(), mols.begin(), mols.end());
+        spilled -= segment.second;
+        loading = false;
+
+        pthread_cond_broadcast(&loaded);
+        pthread_cond_broadcast(&not_empty);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+bool SpillingQueue::ReadSegment(const std::string& fileName, std::deque<Molecule*>& mols)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+    {
+        std::cerr << "Spilled level queue segment " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    std::string encoded;
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        encoded.append(buffer, n);
+    }
+
+    fclose(file);
+    unlink(fileName.c_str());
+
+    return Decode(encoded, mols);
+}
+
+bool SpillingQueue::Decode(const std::string& encoded, std::deque<Molecule*>& mols)
+{
+    const unsigned char* in = (const unsigned char*)encoded.data();
+    const unsigned char* end = in + encoded.size();
+
+    while (in < end)
+    {
+        unsigned length;
+        Molecule* mol = 0;
+
+        if (GetVarint(in, end, length) && length <= (unsigned)(end - in))
+        {
+            mol = Molecule::Reassemble(std::string((const char*)in, length));
+            in += length;
+        }
+
+        if (mol == 0)
+        {
+            std::cerr << "A spilled molecule could not be reassembled." << std::endl;
+            return false;
+        }
+
+        mols.push_back(mol);
+    }
+
+    return true;
+}
+
+// ****************************************************************************
+
+void SpillingQueue::close()
+{
+    pthread_mutex_lock(&lock);
+
+    closed = true;
+
+    pthread_cond_broadcast(&not_empty);
+    pthread_cond_broadcast(&not_full);
+    pthread_mutex_unlock(&lock);
+}
+
+void SpillingQueue::set_capacity(unsigned cap)
+{
+    pthread_mutex_lock(&lock);
+
+    capacity = cap;
+
+    pthread_cond_broadcast(&not_full);
+    pthread_mutex_unlock(&lock);
+}
+
+unsigned SpillingQueue::size()
+{
+    pthread_mutex_lock(&lock);
+    unsigned sz = items.size() + spilled;
+    pthread_mutex_unlock(&lock);
+
+    return sz;
+}
+
+bool SpillingQueue::is_closed()
+{
+    pthread_mutex_lock(&lock);
+    bool c = closed;
+    pthread_mutex_unlock(&lock);
+
+    return c;
+}
+
+unsigned SpillingQueue::get_capacity()
+{
+    pthread_mutex_lock(&lock);
+    unsigned cap = capacity;
+    pthread_mutex_unlock(&lock);
+
+    return cap;
+}
@@ -0,0 +1,132 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPILLING_QUEUE_GUARD
+#define _SPILLING_QUEUE_GUARD 1
+
+
+#include <deque>
+#include <string>
+#include <pthread.h>
+
+
+class Molecule;
+
+//
+// A level queue of molecules (the interface of BoundedQueue) that keeps at most
+// a threshold of molecules in memory once spilling is enabled. Beyond it, each
+// molecule is reduced to its fragment assembly and appended to sequential
+// segment files; the molecule itself is deleted.
+//
+// The order is FIFO throughout: molecules in memory, then the segments in the
+// order written, then the segment being filled. When the molecules in memory
+// run low, a prefetch thread reads and reassembles the next segment so the
+// consumer rarely waits on the disk.
+//
+class SpillingQueue
+{
+  public:
+    SpillingQueue(unsigned capacity = 0);
+    ~SpillingQueue();
+
+    // Spill beyond 'threshold' molecules in memory to segments named <prefix>-<n>.spill.
+    void enable_spill(const std::string& prefix, unsigned threshold);
+
+    // Blocks while the queue is at capacity; false if the queue was closed.
+    bool push(Molecule* const& mol);
+
+    // Blocks while the queue is empty and open; false if closed and drained.
+    bool pop(Molecule*& mol);
+
+    // Non-blocking pop; false if there is nothing queued (spilled molecules are read back).
+    bool try_pop(Molecule*& mol);
+
+    // No more elements will be produced; wake all waiting threads.
+    void close();
+
+    // Adjust the capacity; waiting producers are woken if room was made.
+    void set_capacity(unsigned cap);
+
+    // Molecules queued, in memory and spilled.
+    unsigned size();
+    bool empty() { return size() == 0; }
+    bool is_closed();
+    unsigned get_capacity();
+
+  private:
+    // Bytes of assemblies per segment file
+    static const unsigned SEGMENT_BYTES = 4 << 20;
+
+    std::deque<Molecule*> items;
+    unsigned capacity;
+    bool closed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    //
+    // Spilling state
+    //
+    std::string prefix;
+    unsigned threshold;
+
+    // Spilled molecules: in the segments (written and being read) and the write buffer
+    unsigned spilled;
+
+    // Segment files written and not yet read, in order, with their molecule counts
+    std::deque<std::pair<std::string, unsigned> > segments;
+    unsigned nextSegment;
+
+    // Encoded molecules (varint length, assembly) not yet written to a segment
+    std::string writeBuffer;
+    unsigned writeCount;
+
+    // A segment is being read into memory (by the prefetch thread or a consumer).
+    bool loading;
+    pthread_cond_t loaded;
+
+    pthread_t prefetcher;
+    bool prefetching;
+    bool stopping;
+    pthread_cond_t prefetch_wanted;
+
+    bool full() const { return capacity != 0 && items.size() + spilled >= capacity; }
+    bool spilling() const { return spilled > 0 || (threshold != 0 && items.size() >= threshold); }
+
+    // With the lock held: reassemble the next spilled molecules into memory; false if none.
+    bool refill();
+
+    // Reads and reassembles a segment (without the lock) into the molecules given.
+    static bool ReadSegment(const std::string& fileName, std::deque<Molecule*>& mols);
+
+    // Decode encoded molecules, in order.
+    static bool Decode(const std::string& encoded, std::deque<Molecule*>& mols);
+
+    void flushSegment();
+
+    bool take(Molecule*& mol);
+
+    static void* PrefetchThread(void* queue);
+    void prefetch();
+
+    // Not copyable.
+    SpillingQueue(const SpillingQueue&);
+    SpillingQueue& operator=(const SpillingQueue&);
+};
+
+#endif
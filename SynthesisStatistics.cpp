@@ -0,0 +1,89 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+#include "SynthesisStatistics.h"
+
+
+SynthesisStatistics::SynthesisStatistics(unsigned levels) : numLevels(levels)
+{
+    const unsigned perLine = CACHE_LINE_SIZE / sizeof(unsigned long long);
+
+    stride = ((NUM_COUNTERS + numLevels + perLine - 1) / perLine) * perLine;
+
+    void* mem = 0;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, MAX_SHARDS * stride * sizeof(unsigned long long)) != 0)
+    {
+        throw std::bad_alloc();
+    }
+
+    shards = static_cast<unsigned long long*>(mem);
+    memset(shards, 0, MAX_SHARDS * stride * sizeof(unsigned long long));
+}
+
+SynthesisStatistics::~SynthesisStatistics()
+{
+    free(shards);
+}
+
+//
+// Threads are handed shards round-robin the first time they count anything.
+//
+unsigned SynthesisStatistics::threadShard()
+{
+    static unsigned nextShard = 0;
+    static __thread int shard = -1;
+
+    if (shard < 0) shard = __sync_fetch_and_add(&nextShard, 1) % MAX_SHARDS;
+
+    return shard;
+}
+
+unsigned long long SynthesisStatistics::sum(unsigned index) const
+{
+    unsigned long long total = 0;
+
+    for (unsigned s = 0; s < MAX_SHARDS; s++)
+    {
+        total += __sync_add_and_fetch(&shards[s * stride + index], 0);
+    }
+
+    return total;
+}
+
+SynthesisStatistics::Snapshot SynthesisStatistics::snapshot() const
+{
+    Snapshot snap;
+
+    for (unsigned c = 0; c < NUM_COUNTERS; c++)
+    {
+        snap.counters[c] = sum(c);
+    }
+
+    snap.processed.resize(numLevels, 0);
+    for (unsigned level = 0; level < numLevels; level++)
+    {
+        snap.processed[level] = sum(NUM_COUNTERS + level);
+    }
+
+    return snap;
+}
@@ -0,0 +1,105 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SYNTHESIS_STATISTICS_GUARD
+#define _SYNTHESIS_STATISTICS_GUARD 1
+
+
+#include <vector>
+
+
+//
+// Molecule counts maintained during synthesis.
+//
+// Each thread increments its own shard; shards are padded to a cache line so
+// threads never write to the same line. Totals are computed on demand by
+// summing the shards (snapshot), which is cheap relative to synthesis.
+//
+class SynthesisStatistics
+{
+  public:
+    enum Counter
+    {
+        INCLUDED,          // Molecules accepted and output
+        PROB_EXCLUDED,     // Molecules removed by probabilistic pruning
+        LEVEL_FILTERED,    // Duplicates caught by the level bloom filter
+        OVERALL_FILTERED,  // Duplicates caught by the overall bloom filter
+        TARGET_PRUNED,     // Molecules unable to reach a target (target-directed)
+        NUM_COUNTERS
+    };
+
+    //
+    // Aggregated totals at the time of the snapshot.
+    //
+    struct Snapshot
+    {
+        unsigned long long counters[NUM_COUNTERS];
+
+        // Molecules processed (composed with the base molecules) at each level
+        std::vector<unsigned long long> processed;
+
+        unsigned long long included() const { return counters[INCLUDED]; }
+        unsigned long long excluded() const { return counters[PROB_EXCLUDED]; }
+    };
+
+    SynthesisStatistics(unsigned numLevels);
+    ~SynthesisStatistics();
+
+    // Each returns the calling thread's shard value after the increment (not the total).
+    unsigned long long increment(Counter c) { return add(slot(c), 1); }
+    void processed(unsigned level) { add(slot(NUM_COUNTERS + level), 1); }
+
+    void addProcessed(unsigned level, unsigned long long n) { add(slot(NUM_COUNTERS + level), n); }
+    void add(Counter c, unsigned long long n) { add(slot(c), n); }
+
+    // Totals over all shards
+    unsigned long long get(Counter c) const { return sum(c); }
+    unsigned long long getProcessed(unsigned level) const { return sum(NUM_COUNTERS + level); }
+
+    Snapshot snapshot() const;
+
+  private:
+    static const unsigned CACHE_LINE_SIZE = 64;
+
+    // Threads beyond this number share shards (updates remain atomic).
+    static const unsigned MAX_SHARDS = 64;
+
+    unsigned numLevels;
+
+    // Number of counters per shard, rounded up to a whole number of cache lines
+    unsigned stride;
+
+    unsigned long long* shards;
+
+    // The shard index of the calling thread; assigned on first use.
+    static unsigned threadShard();
+
+    unsigned long long* slot(unsigned index) { return &shards[threadShard() * stride + index]; }
+
+    static unsigned long long add(unsigned long long* counter, unsigned long long n)
+    {
+        return __sync_add_and_fetch(counter, n);
+    }
+
+    unsigned long long sum(unsigned index) const;
+
+    // Not copyable.
+    SynthesisStatistics(const SynthesisStatistics&);
+    SynthesisStatistics& operator=(const SynthesisStatistics&);
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+
+#include <openbabel/mol.h>
+#include <openbabel/obconversion.h>
+#include <openbabel/query.h>
+#include <openbabel/isomorphism.h>
+
+
+#include "TargetSet.h"
+#include "Molecule.h"
+#include "Atom.h"
+#include "BlockFormat.h"
+#include "Checkpoint.h"
+
+
+TargetSet::TargetSet() : found(0), decomposed(false)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+TargetSet::~TargetSet()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+//
+// OpenBabel atomic numbers to our elements
+//
+static AtomEnumT Element(unsigned atomicNum)
+{
+    switch (atomicNum)
+    {
+      case 1:  return ATOM_T_HYDROGEN;
+      case 5:  return ATOM_T_BORON;
+      case 6:  return ATOM_T_CARBON;
+      case 7:  return ATOM_T_NITROGEN;
+      case 8:  return ATOM_T_OXYGEN;
+      case 9:  return ATOM_T_FLUORINE;
+      case 15: return ATOM_T_PHOSPHORUS;
+      case 16: return ATOM_T_SULFUR;
+      case 17: return ATOM_T_CHLORINE;
+      case 35: return ATOM_T_BROMINE;
+      case 53: return ATOM_T_IODINE;
+    }
+
+    return ATOM_T_UNKNOWN;
+}
+
+//
+// FNV-1a over the heavy-atom counts; hydrogens are not counted.
+//
+unsigned long long TargetSet::FormulaHash(const unsigned counts[ATOM_T_UNKNOWN + 1])
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned e = 0; e <= ATOM_T_UNKNOWN; e++)
+    {
+        if (e == ATOM_T_HYDROGEN) continue;
+
+        hash = (hash ^ counts[e]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+bool TargetSet::Canonicalize(const std::string& smi, std::string& canonical)
+{
+    // Begin open babel usage
+    pthread_mutex_lock(& Molecule::openbabel_lock);
+
+    OpenBabel::OBMol mol;
+    OpenBabel::OBConversion conv;
+    bool converted = conv.SetInAndOutFormats("SMI", "CAN") && conv.ReadString(&mol, smi);
+    if (converted) canonical = conv.WriteString(&mol);
+
+    // End open babel usage
+    pthread_mutex_unlock(& Molecule::openbabel_lock);
+
+    if (!converted) return false;
+
+    // Only the SMILES; not the title or line end
+    canonical = canonical.substr(0, canonical.find_first_of("\t\r\n "));
+
+    return !canonical.empty();
+}
+
+bool TargetSet::load(const std::string& fileName)
+{
+    std::ifstream in(fileName.c_str());
+    if (!in)
+    {
+        std::cerr << "Target file " << fileName << " could not be opened." << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream iss(line);
+
+        Target target;
+        if (!(iss >> target.smi)) continue;
+
+        iss >> std::ws;
+        std::getline(iss, target.name);
+        if (target.name.empty()) target.name = target.smi;
+
+        //
+        // The heavy-atom formula
+        //
+        OpenBabel::OBMol mol;
+        OpenBabel::OBConversion conv;
+        if (!conv.SetInFormat("SMI") || !conv.ReadString(&mol, target.smi) ||
+            !Canonicalize(target.smi, target.canonical))
+        {
+            std::cerr << "Target " << target.name << " (" << target.smi
+                      << ") could not be read; ignored." << std::endl;
+            continue;
+        }
+
+        unsigned counts[ATOM_T_UNKNOWN + 1];
+        memset(counts, 0, sizeof(counts));
+        for (unsigned a = 1; a <= mol.NumAtoms(); a++)
+        {
+            counts[Element(mol.GetAtom(a)->GetAtomicNum())]++;
+        }
+
+        target.found = false;
+        target.level = 0;
+
+        byFormula[FormulaHash(counts)].push_back(targets.size());
+        targets.push_back(target);
+    }
+
+    std::cerr << "Seeking " << targets.size() << " targets from " << fileName << std::endl;
+
+    return !targets.empty();
+}
+
+//
+// An assembly as text: <fragment> then <atom>:<fragment>:<atom> per bond (as blockextract).
+//
+static std::string FormatAssembly(const std::string& assembly, unsigned numValues)
+{
+    const unsigned char* in = (const unsigned char*)assembly.data();
+    const unsigned char* end = in + assembly.size();
+
+    std::ostringstream oss;
+    unsigned value;
+    for (unsigned v = 0; v < numValues && GetVarint(in, end, value); v++)
+    {
+        if (v == 0) oss << value;
+        else oss << (v % 3 == 1 ? " " : ":") << value;
+    }
+
+    return oss.str();
+}
+
+bool TargetSet::check(const Molecule& mol, const std::string& smi, unsigned level)
+{
+    if (complete()) return false;
+
+    //
+    // The formula lookup; most molecules go no further.
+    //
+    unsigned counts[ATOM_T_UNKNOWN + 1];
+    memset(counts, 0, sizeof(counts));
+    for (int a = 0; a < mol.getNumberOfAtoms(); a++)
+    {
+        counts[mol.getAtom(a)->getAtomType().getElement()]++;
+    }
+
+    std::map<unsigned long long, std::vector<unsigned> >::const_iterator it =
+                                                     byFormula.find(FormulaHash(counts));
+    if (it == byFormula.end()) return false;
+
+    std::string canonical;
+    if (!Canonicalize(smi, canonical)) return false;
+
+    bool newlyFound = false;
+
+    pthread_mutex_lock(&lock);
+
+    for (unsigned t = 0; t < it->second.size(); t++)
+    {
+        Target& target = targets[it->second[t]];
+        if (target.found || target.canonical != canonical) continue;
+
+        // Each composition adds three values to the assembly.
+        unsigned numValues = 1 + 3 * (level - 1);
+
+        target.found = true;
+        target.level = level;
+        target.assembly = FormatAssembly(mol.getAssembly(), numValues);
+        target.parent = FormatAssembly(mol.getAssembly(), numValues - 3);
+
+        found++;
+        newlyFound = true;
+
+        std::cerr << "Target " << target.name << " synthesized at level " << level
+                  << " (" << found << " of " << targets.size() << "): " << smi << std::endl;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return newlyFound;
+}
+
+void TargetSet::report(std::ostream& os) const
+{
+    os << "Targets found: " << found << " of " << targets.size() << std::endl;
+    os << "Target\tSMILES\tLevel\tAssembly\tParent" << std::endl;
+
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        const Target& target = targets[t];
+
+        os << target.name << "\t" << target.smi << "\t";
+        if (target.found) os << target.level << "\t" << target.assembly << "\t" << target.parent;
+        else os << "-\t-\t-";
+        os << std::endl;
+    }
+}
+
+// ****************************************************************************
+
+void TargetSet::decompose(const std::vector<Molecule*>& fragments)
+{
+    //
+    // The targets and fragments as OpenBabel molecules (heavy atoms only)
+    //
+    OpenBabel::OBConversion conv;
+    conv.SetInFormat("SMI");
+
+    std::vector<OpenBabel::OBMol> targetMols(targets.size());
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        conv.ReadString(&targetMols[t], targets[t].smi);
+    }
+
+    for (unsigned f = 0; f < fragments.size(); f++)
+    {
+        OpenBabel::OBMol fragmentMol;
+        conv.ReadString(&fragmentMol, fragments[f]->ConstructSMI());
+        fragmentMol.DeleteHydrogens();
+
+        OpenBabel::OBQuery* query = OpenBabel::CompileMoleculeQuery(&fragmentMol);
+        OpenBabel::OBIsomorphismMapper* mapper = OpenBabel::OBIsomorphismMapper::GetInstance(query);
+
+        for (unsigned t = 0; t < targets.size(); t++)
+        {
+            // Each distinct set of target atoms matched; overlapping matches make this a bound.
+            OpenBabel::OBIsomorphismMapper::Mappings mappings;
+            mapper->MapUnique(&targetMols[t], mappings);
+
+            if (!mappings.empty()) targets[t].fragments.push_back(std::make_pair(f, (unsigned)mappings.size()));
+        }
+
+        delete mapper;
+        delete query;
+    }
+
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        if (targets[t].fragments.empty())
+        {
+            std::cerr << "Target " << targets[t].name << " contains none of the fragments." << std::endl;
+        }
+    }
+
+    decomposed = true;
+}
+
+bool TargetSet::reachable(const Molecule& mol) const
+{
+    //
+    // The fragments of this molecule; few, relative to the base molecules.
+    //
+    std::vector<std::pair<unsigned, unsigned> > counts;
+    for (unsigned f = 0; f < Molecule::NUM_UNIQUE_FRAGMENTS; f++)
+    {
+        if (mol.getFragmentCount(f) > 0) counts.push_back(std::make_pair(f, mol.getFragmentCount(f)));
+    }
+
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        // Read without the lock; a target found concurrently is merely considered once more.
+        if (targets[t].found) continue;
+
+        const std::vector<std::pair<unsigned, unsigned> >& bounds = targets[t].fragments;
+
+        bool fits = true;
+        for (unsigned c = 0; c < counts.size() && fits; c++)
+        {
+            std::vector<std::pair<unsigned, unsigned> >::const_iterator it =
+                std::lower_bound(bounds.begin(), bounds.end(), std::make_pair(counts[c].first, 0U));
+
+            fits = it != bounds.end() && it->first == counts[c].first && it->second >= counts[c].second;
+        }
+
+        if (fits) return true;
+    }
+
+    return false;
+}
+
+// ****************************************************************************
+
+unsigned long long TargetSet::hash() const
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        const std::string& canonical = targets[t].canonical;
+        for (unsigned c = 0; c < canonical.size(); c++)
+        {
+            hash = (hash ^ (unsigned char)canonical[c]) * 1099511628211ULL;
+        }
+
+        // Separate the targets.
+        hash = (hash ^ '\n') * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void TargetSet::write(Checkpoint& checkpoint) const
+{
+    checkpoint.putU32(targets.size());
+    for (unsigned t = 0; t < targets.size(); t++)
+    {
+        checkpoint.putU32(targets[t].found);
+        checkpoint.putU32(targets[t].level);
+        checkpoint.putBytes(targets[t].assembly);
+        checkpoint.putBytes(targets[t].parent);
+    }
+}
+
+bool TargetSet::read(Checkpoint& checkpoint)
+{
+    if (checkpoint.getU32() != targets.size()) return false;
+
+    found = 0;
+    for (unsigned t = 0; t < targets.size() && checkpoint.ok(); t++)
+    {
+        targets[t].found = checkpoint.getU32() != 0;
+        targets[t].level = checkpoint.getU32();
+        checkpoint.getBytes(targets[t].assembly);
+        checkpoint.getBytes(targets[t].parent);
+
+        if (targets[t].found) found++;
+    }
+
+    return checkpoint.ok();
+}
@@ -0,0 +1,117 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _TARGET_SET_GUARD
+#define _TARGET_SET_GUARD 1
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <iostream>
+#include <pthread.h>
+
+
+#include "AtomT.h"
+
+
+class Molecule;
+class Checkpoint;
+
+//
+// Reference molecules (-targets) sought during synthesis.
+//
+// Each target is kept as its canonical SMILES, keyed by a hash of its heavy-atom
+// formula. A synthesized molecule is looked up by the formula hash computed
+// from its atom types; only on a formula match is its SMILES (the dedup key)
+// canonicalized and compared. A target is recorded once: the level, the
+// assembly, and the parent (the assembly less its last composition).
+//
+// For target-directed synthesis, each target is decomposed into a bound on the
+// number of each base fragment it may contain: the number of distinct places
+// the fragment matches as a substructure (heavy atoms, bond orders, and
+// aromaticity). A molecule exceeding the bounds of every target not yet found
+// can never become one, nor can anything composed from it.
+//
+class TargetSet
+{
+  public:
+    TargetSet();
+    ~TargetSet();
+
+    // Read SMILES, one per line, optionally followed by a name.
+    bool load(const std::string& fileName);
+
+    unsigned size() const { return targets.size(); }
+    bool empty() const { return targets.empty(); }
+    unsigned numFound() const { return found; }
+    bool complete() const { return !targets.empty() && found == targets.size(); }
+
+    // Is the molecule (with the SMILES given) a target not found before? Safe for any thread.
+    bool check(const Molecule& mol, const std::string& smi, unsigned level);
+
+    // Every target, found or not.
+    void report(std::ostream& os) const;
+
+    // Bound the fragments of every target by the base molecules (ordered by unique index id).
+    void decompose(const std::vector<Molecule*>& fragments);
+    bool isDecomposed() const { return decomposed; }
+
+    // Is the molecule within the fragment bounds of a target not yet found?
+    bool reachable(const Molecule& mol) const;
+
+    // Identifies the targets (their canonical SMILES, in order) among run settings.
+    unsigned long long hash() const;
+
+    // Save and restore what has been found (level, assembly, and parent of each target).
+    void write(Checkpoint& checkpoint) const;
+    bool read(Checkpoint& checkpoint);
+
+  private:
+    struct Target
+    {
+        std::string name;
+        std::string smi;
+        std::string canonical;
+
+        bool found;
+        unsigned level;
+        std::string assembly;
+        std::string parent;
+
+        // (base fragment, the most it may occur) in fragment order; absent fragments may not occur.
+        std::vector<std::pair<unsigned, unsigned> > fragments;
+    };
+
+    std::vector<Target> targets;
+
+    // Targets by formula hash
+    std::map<unsigned long long, std::vector<unsigned> > byFormula;
+
+    volatile unsigned found;
+    bool decomposed;
+    pthread_mutex_t lock;
+
+    static unsigned long long FormulaHash(const unsigned counts[ATOM_T_UNKNOWN + 1]);
+    static bool Canonicalize(const std::string& smi, std::string& canonical);
+
+    // Not copyable.
+    TargetSet(const TargetSet&);
+    TargetSet& operator=(const TargetSet&);
+};
+
+#endif
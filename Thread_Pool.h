@@ -21,80 +21,131 @@
 
 #include <iostream>
 #include <queue>
-#include <unistd.h>
 #include <pthread.h>
 
 
+#include "BoundedQueue.h"
+
+
 template <class In_Type, class Out_Type> class Thread_Pool;
-template <class In_Type, class Out_Type> void *process_data_func(void * This);
 template <class In_Type, class Out_Type> void *worker_func(void * This);
 
 
+//
+// A fixed set of worker threads applying a processing function to submitted items.
+//
+// Workers block on the input queue; there is no manager thread and no polling.
+// With a non-zero capacity, submission blocks while the input queue is full
+// (backpressure on the producer). Results go to the completion callback given
+// with the item or, if none was given, to the output queue (front / pop).
+//
 template <class In_Type, class Out_Type>
 class Thread_Pool
 {
   public:
+    // Invoked on the worker thread once an item has been processed.
+    typedef void (*Callback)(const In_Type& in, const Out_Type& out, void* context);
+
     Thread_Pool(Out_Type (*p)(In_Type)); // function pointer only
-    Thread_Pool(int num_threads, Out_Type (*p)(In_Type)); // num threads and function pointer
-    ~Thread_Pool(); // destructor
+    Thread_Pool(int num_threads, Out_Type (*p)(In_Type), unsigned capacity = 0); // num threads and function pointer
+    ~Thread_Pool(); // destructor; completes all submitted items
     void print(); // display some debuggin info
 
-    void push(In_Type data); // push
+    void push(In_Type data); // push; result to the output queue
+    void submit(In_Type data, Callback callback, void* context = 0); // push; result to the callback
+    void wait_idle(); // block until every submitted item has completed
+
     int in_q_size(); // size of un-processed item q
     int out_q_size(); // size of processed item q
     Out_Type front(); // front
     void pop(); // pop
 
   private:
-    pthread_t _manager; // for manager thread
+    struct Task
+    {
+        In_Type data;
+        Callback callback;
+        void* context;
+    };
+
     pthread_t *threads; // for worker threads
     int num_threads; // total threads
-    std::queue<In_Type> in_q; // items to be processed
+    BoundedQueue<Task> in_q; // items to be processed
     std::queue<Out_Type> out_q; // finished results
-    pthread_mutex_t lock_in_q, lock_out_q; // mutex locks for q's
+    pthread_mutex_t lock_out_q; // mutex lock for results
+
+    // Items submitted but not yet completed (queued or in progress)
+    unsigned pending;
+    pthread_mutex_t lock_pending;
+    pthread_cond_t idle;
 
     Out_Type (*process)(In_Type); // misc processing function entered by user
-    bool processing_data; // flag to stop processing data - threads will all die, currently no way to start again excpet making a new thread pool
-    void process_data(); // asynchronously process all incoming data
-    void stop_processing(); // finish with in-progress data then stop processing
+    void start(); // spawn the workers
+    void enqueue(const Task& task);
+    void complete(const Task& task, const Out_Type& out);
 
-    //template <class In_Type, class Out_Type> friend void *process_data_func(void * This);
-    friend void *process_data_func<In_Type, Out_Type>(void * This); // manager thread
     friend void *worker_func<In_Type, Out_Type>(void * This); // worker thread
 };
 
 template <class In_Type, class Out_Type>
-Thread_Pool<In_Type, Out_Type>::Thread_Pool(Out_Type (*p)(In_Type))
+Thread_Pool<In_Type, Out_Type>::Thread_Pool(Out_Type (*p)(In_Type)) : num_threads(10),
+                                                                      pending(0),
+                                                                      process(p)
 {
-    num_threads = 10;
-    threads=new pthread_t[num_threads];
-
-    process=p;
-
-    pthread_mutex_init(&lock_in_q, NULL);
-    pthread_mutex_init(&lock_out_q, NULL);
+    start();
+}
 
-    process_data();
+template <class In_Type, class Out_Type>
+Thread_Pool<In_Type, Out_Type>::Thread_Pool(int num_threads, Out_Type (*p)(In_Type),
+                                            unsigned capacity) : num_threads(num_threads),
+                                                                 in_q(capacity),
+                                                                 pending(0),
+                                                                 process(p)
+{
+    start();
 }
 
+//
+// Finish with all submitted data then stop processing
+//
 template <class In_Type, class Out_Type>
-Thread_Pool<In_Type, Out_Type>::Thread_Pool(int num_threads, Out_Type (*p)(In_Type))
+Thread_Pool<In_Type, Out_Type>::~Thread_Pool()
 {
-    this->num_threads = num_threads;
-    threads = new pthread_t[num_threads];
+    // Workers drain the queue, then leave.
+    in_q.close();
 
-    process = p;
+    for (int x = 0; x < num_threads; x++)
+    {
+        (void) pthread_join(threads[x], NULL);
+    }
 
-    pthread_mutex_init(&lock_in_q, NULL);
-    pthread_mutex_init(&lock_out_q, NULL);
+    delete[] threads;
 
-    process_data();
+    pthread_cond_destroy(&idle);
+    pthread_mutex_destroy(&lock_pending);
+    pthread_mutex_destroy(&lock_out_q);
 }
 
 template <class In_Type, class Out_Type>
-Thread_Pool<In_Type, Out_Type>::~Thread_Pool()
+void Thread_Pool<In_Type, Out_Type>::start()
 {
-    stop_processing();
+    pthread_mutex_init(&lock_out_q, NULL);
+    pthread_mutex_init(&lock_pending, NULL);
+    pthread_cond_init(&idle, NULL);
+
+    threads = new pthread_t[num_threads];
+
+    for (int x = 0; x < num_threads; x++)
+    {
+        if (pthread_create(&threads[x], NULL, worker_func<In_Type, Out_Type>, this) != 0)
+        {
+            std::cerr << "worker " << x << " creation failed" << std::endl;
+
+            // Only the workers created thus far will be joined.
+            num_threads = x;
+            break;
+        }
+    }
 }
 
 //
@@ -111,24 +162,77 @@ void Thread_Pool<In_Type, Out_Type>::print()
 template <class In_Type, class Out_Type>
 void Thread_Pool<In_Type, Out_Type>::push(In_Type data)
 {
-    pthread_mutex_lock(&lock_in_q);
-    in_q.push(data);
-    pthread_mutex_unlock(&lock_in_q);
+    Task task;
+    task.data = data;
+    task.callback = 0;
+    task.context = 0;
+
+    enqueue(task);
+}
+
+template <class In_Type, class Out_Type>
+void Thread_Pool<In_Type, Out_Type>::submit(In_Type data, Callback callback, void* context)
+{
+    Task task;
+    task.data = data;
+    task.callback = callback;
+    task.context = context;
+
+    enqueue(task);
 }
 
 //
-// size of unprocessed item queue
+// Blocks while the input queue is at capacity.
 //
 template <class In_Type, class Out_Type>
-int Thread_Pool<In_Type, Out_Type>::in_q_size()
+void Thread_Pool<In_Type, Out_Type>::enqueue(const Task& task)
 {
-    int size;
+    pthread_mutex_lock(&lock_pending);
+    pending++;
+    pthread_mutex_unlock(&lock_pending);
 
-    pthread_mutex_lock(&lock_in_q);
-    size = in_q.size();
-    pthread_mutex_unlock(&lock_in_q);
+    in_q.push(task);
+}
 
-    return size;
+template <class In_Type, class Out_Type>
+void Thread_Pool<In_Type, Out_Type>::complete(const Task& task, const Out_Type& out)
+{
+    if (task.callback)
+    {
+        task.callback(task.data, out, task.context);
+    }
+    else
+    {
+        pthread_mutex_lock(&lock_out_q);
+        out_q.push(out);
+        pthread_mutex_unlock(&lock_out_q);
+    }
+
+    pthread_mutex_lock(&lock_pending);
+    if (--pending == 0) pthread_cond_broadcast(&idle);
+    pthread_mutex_unlock(&lock_pending);
+}
+
+template <class In_Type, class Out_Type>
+void Thread_Pool<In_Type, Out_Type>::wait_idle()
+{
+    pthread_mutex_lock(&lock_pending);
+
+    while (pending > 0)
+    {
+        pthread_cond_wait(&idle, &lock_pending);
+    }
+
+    pthread_mutex_unlock(&lock_pending);
+}
+
+//
+// size of unprocessed item queue
+//
+template <class In_Type, class Out_Type>
+int Thread_Pool<In_Type, Out_Type>::in_q_size()
+{
+    return in_q.size();
 }
 
 //
@@ -166,110 +270,21 @@ void Thread_Pool<In_Type, Out_Type>::pop()
     pthread_mutex_unlock(&lock_out_q);
 }
 
-//
-// asynchronously process all incoming data
-//
-template <class In_Type, class Out_Type>
-void Thread_Pool<In_Type, Out_Type>::process_data()
-{
-    processing_data = true;
-
-    if (~pthread_create(&_manager, NULL, process_data_func<In_Type, Out_Type>, this))
-    {
-        std::cout << "Thread pool manager created." << std::endl;
-    }
-    else
-    {
-        std::cout << "Thread pool manager creation failed." << std::endl;
-        processing_data = false;
-    }
-}
-
-//
-// Finish with in-progress data then stop processing
-//
-template <class In_Type, class Out_Type>
-void Thread_Pool<In_Type, Out_Type>::stop_processing()
-{
-// std::cerr << "Stop Processing signal given." << std::endl;
-
-    processing_data = false;
-
-//std::cerr << "Before Manager join." << std::endl;
-
-    (void) pthread_join(_manager, NULL);
-
-//std::cerr << "After manager join." << std::endl;
-}
-
-template <class In_Type, class Out_Type>
-void *process_data_func(void *This_void)
-{
-    // manager thread
-    // init
-    Thread_Pool<In_Type, Out_Type>* This = (Thread_Pool<In_Type, Out_Type> *)This_void;
-
-    // spawn workers
-    for (int x = 0; x < This->num_threads; x++)
-    {
-        if(~pthread_create(&This->threads[x], NULL, worker_func<In_Type, Out_Type>, This_void))
-            std::cout << "worker " << x << " created" << std::endl;
-        else
-            std::cout << "worker " << x << " creation failed" << std::endl;
-    }
-
-    // manage workers
-    while(This->processing_data)
-    {
-        sleep(1); // sleep 1 second
-    } // not much to manage atm, sleep() maybe?
-
-    // de-spawn workers
-    for (int x = 0; x < This->num_threads; x++)
-    {
-        (void) pthread_join(This->threads[x], NULL);
-        std::cerr << "worker " << x << " removed" << std::endl;
-    }
-
-    // exit
-    pthread_exit(NULL);
-}
-
 template <class In_Type, class Out_Type>
 void *worker_func(void *This_void)
 { // worker thread
-    // init
     Thread_Pool<In_Type, Out_Type> * This=(Thread_Pool<In_Type, Out_Type> *)This_void;
-    In_Type in;
-    Out_Type out;
+    typename Thread_Pool<In_Type, Out_Type>::Task task;
 
-    while(This->processing_data)
+    // Blocks while there is nothing to do; false once the pool is closed and drained.
+    while (This->in_q.pop(task))
     {
-        // pop
-        pthread_mutex_lock(&This->lock_in_q);
-        if (This->in_q.size()>0)
-        {
-            in=This->in_q.front();
-            This->in_q.pop();
-            pthread_mutex_unlock(&This->lock_in_q);
-        }
-        else
-        {
-            pthread_mutex_unlock(&This->lock_in_q);
-            continue;
-        }
-
-        // process
-        out=This->process(in);
+        Out_Type out = This->process(task.data);
 
-        // push
-        pthread_mutex_lock(&This->lock_out_q);
-        This->out_q.push(out);
-        pthread_mutex_unlock(&This->lock_out_q);
+        This->complete(task, out);
     }
 
-    //exit
-    pthread_exit(NULL);
+    return 0;
 }
 
 // list all possile templates or move implementation into .h file...
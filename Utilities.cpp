@@ -248,6 +248,32 @@ void CleanDirectory(const std::string& theDir)
     }
 }
 
+//
+// The files in the directory with the given suffix, sorted by name.
+//
+void ListDirectory(const std::string& theDir, const std::string& suffix,
+                   std::vector<std::string>& files)
+{
+    DIR *theFolder = opendir(theDir.c_str());
+    if (theFolder == NULL) return;
+
+    struct dirent *next_file;
+    while ((next_file = readdir(theFolder)) != NULL)
+    {
+        std::string name = next_file->d_name;
+
+        if (name.size() > suffix.size() &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            files.push_back(theDir + "/" + name);
+        }
+    }
+
+    closedir(theFolder);
+
+    std::sort(files.begin(), files.end());
+}
+
 void MakeDirectory(const std::string& theDir)
 {
     if (!DoesDirectoryExist(theDir))
@@ -69,6 +69,8 @@ bool ContainsFalse(const vector<bool>& vec);
 void MakeDirectory(const std::string& theDir);
 bool DoesDirectoryExist(const std::string& theDir);
 void CleanDirectory(const std::string& theDir);
+void ListDirectory(const std::string& theDir, const std::string& suffix,
+                   std::vector<std::string>& files);
 
 //
 // Probability distributions
@@ -17,11 +17,12 @@
 
 #include <vector>
 #include <fstream>
+#include <pthread.h>
+#include <unistd.h>
 
 
 #include <openbabel/mol.h>
 #include <openbabel/obconversion.h>
-#include <openbabel/fingerprint.h>
 
 
 //#include "HyperGraph.h"
@@ -31,118 +32,161 @@
 #include "Constants.h"
 
 //
-// Validate a single molecule.
+// Log the closest synthesized molecule to a validation molecule; is it close enough?
 //
-bool Validator::Validate(OpenBabel::OBMol& validationMol)
+bool Validator::Record(std::ostream& logfile, OpenBabel::OBMol& validationMol,
+                       double maxTanimoto, int maxIndex) const
 {
-    std::vector<unsigned int> validationFP;
-    bool returnval = false;
+    bool returnval = maxTanimoto > (double)Options::TANIMOTO;
+
+    logfile << "Validation Molecule: " << validationMol.GetTitle() << " with ";
+    logfile << "Synth Molecule: " << (maxIndex < 0 ? "" : this->molecules.name(maxIndex)) << "\n";
+    logfile << maxIndex << ": maxTanimoto = " << maxTanimoto;
+    // if (returnval) logfile << " - Validated\n";
+    // else logfile << " - Failed to Validate\n";
+    logfile << std::endl;
 
+    return returnval;
+}
+
+//
+// Acquire the fingerprint of a validation molecule so we can use it for
+// Tanimoto comparison.
+//
+static void ValidationFingerprint(OpenBabel::OBMol& validationMol, unsigned long long* fp)
+{
     if (g_debug_output)
     {
         std::cerr << "Atoms: " << validationMol.NumAtoms() << std::endl;
         std::cerr << "Bonds: " << validationMol.NumBonds() << std::endl;
     }
 
-    // Create the fingerprint for the validation molecule
-    OpenBabel::OBFingerprint* fpType = OpenBabel::OBFingerprint::FindFingerprint("");
-
-    // Acquire the fingerprint of the validation molecule so we can use it for
-    // Tanimoto comparison.
-    fpType->GetFingerprint(&validationMol, validationFP);
+    Fingerprint::Compute(validationMol, fp);
 
     if (g_debug_output)
     {
         std::cerr << "Validation: " << std::endl;
-        foreach_uints(u_it, validationFP)
+        for (unsigned w = 0; w < Fingerprint::WORDS; w++)
         {
-            std::cerr << *u_it << "|";
+            std::cerr << fp[w] << "|";
         }
         std::cerr << std::endl;
     }
+}
+
+//
+// Validate a single molecule.
+//
+bool Validator::Validate(OpenBabel::OBMol& validationMol)
+{
+    unsigned long long validationFP[Fingerprint::WORDS];
+    ValidationFingerprint(validationMol, validationFP);
 
     //
-    // Check this validation fingerprint against all of fingerprints in the list of
-    // valid molecules.
-    // 
-    // Tracks the largest tanimoto coefficient of the synthesized molecule (and index?)
+    // Find the synthesized molecule with the largest tanimoto coefficient (and index).
     //
-    double maxTanimoto = -1;
-    int maxIndex = -1;
-    int molIndex = 0;
-    foreach_obmol_points(m_it, this->molecules)
-    {
-        // Acquire the fingerprint of the hypergraph molecule.
-        std::vector<unsigned int> hgFP;
-        OpenBabel::OBFingerprint* fpType = OpenBabel::OBFingerprint::FindFingerprint("");
-        fpType->GetFingerprint(*m_it, hgFP);
-
-        // Debug output of the fingerprint.
-        if (g_debug_output)
-        {
-            std::cerr << "Hypergraph: " << std::endl;
-            foreach_uints(u_it, hgFP)
-            {
-                std::cerr << *u_it << "|";
-            }
-            std::cerr << std::endl;
-        }
-
-        // Acquire the tanimoto coefficient for the validation molecule and
-        // the synthesized molecules in the hypergraph.
-        double tanimoto = OpenBabel::OBFingerprint::Tanimoto(validationFP, hgFP);
-
-        if (tanimoto > maxTanimoto)
-        {
-            maxTanimoto = tanimoto;
-            maxIndex = molIndex;
-        }
-
-        if (g_debug_output) std::cerr << "Tanimoto: " << tanimoto << std::endl;
-
-        if (tanimoto > (double)Options::TANIMOTO) 
-        {
-            returnval = true;
-            break;
-        }
-
-        molIndex++;
-    }
-
+    int maxIndex;
+    double maxTanimoto = this->molecules.best(validationFP, maxIndex);
 
     std::ofstream logfile("Validation_logfile.txt", std::ofstream::out | std::ofstream::app); // append
-    logfile << "Validation Molecule: " << validationMol.GetTitle() << " with ";
-    logfile << "Synth Molecule: " << this->molecules[maxIndex]->GetTitle() << "\n";
-    logfile << maxIndex << ": maxTanimoto = " << maxTanimoto;
-    // if (returnval) logfile << " - Validated\n";
-    // else logfile << " - Failed to Validate\n";
-    logfile << std::endl;
+    bool returnval = Record(logfile, validationMol, maxTanimoto, maxIndex);
     logfile.close();
 
     return returnval;
 }
 
+//
+// Search threads claim validation molecules in turn; the index is only read.
+//
+struct SearchArgs
+{
+    const FingerprintIndex* index;
+    const std::vector<unsigned long long>* fingerprints;
+    std::vector<double>* maxTanimotos;
+    std::vector<int>* maxIndices;
+    volatile unsigned next;
+};
+
+static void* SearchThread(void* args_void)
+{
+    SearchArgs* args = static_cast<SearchArgs*>(args_void);
+
+    unsigned q;
+    while ((q = __sync_fetch_and_add(&args->next, 1)) < args->maxTanimotos->size())
+    {
+        (*args->maxTanimotos)[q] = args->index->best(&(*args->fingerprints)[q * Fingerprint::WORDS],
+                                                     (*args->maxIndices)[q]);
+    }
+
+    return 0;
+}
 
 //
 // Validate a list of molecules.
 //
 void Validator::Validate(std::vector<OpenBabel::OBMol>& molsToValidate)
 {
-    int counter = 1;
+    if (molsToValidate.empty()) return;
+
+    //
+    // Fingerprints are computed here, serially (OpenBabel perception is not thread-safe);
+    // the searches run concurrently.
+    //
+    std::vector<unsigned long long> fingerprints(molsToValidate.size() * Fingerprint::WORDS);
+    for (unsigned m = 0; m < molsToValidate.size(); m++)
+    {
+        ValidationFingerprint(molsToValidate[m], &fingerprints[m * Fingerprint::WORDS]);
+    }
+
+    std::vector<double> maxTanimotos(molsToValidate.size());
+    std::vector<int> maxIndices(molsToValidate.size());
+
+    SearchArgs args;
+    args.index = &this->molecules;
+    args.fingerprints = &fingerprints;
+    args.maxTanimotos = &maxTanimotos;
+    args.maxIndices = &maxIndices;
+    args.next = 0;
+
+    unsigned numThreads = Options::VALIDATE_THREADS;
+    if (numThreads == 0) numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads > molsToValidate.size()) numThreads = molsToValidate.size();
+    if (numThreads == 0) numThreads = 1;
+
+    std::vector<pthread_t> threads(numThreads - 1);
+    unsigned started = 0;
+    for ( ; started < threads.size(); started++)
+    {
+        if (pthread_create(&threads[started], NULL, SearchThread, &args) != 0) break;
+    }
+
+    // This thread searches as well.
+    SearchThread(&args);
+
+    for (unsigned t = 0; t < started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
 
-    foreach_obmols(m_it, molsToValidate)
+    //
+    // Report in input order.
+    //
+    std::ofstream logfile("Validation_logfile.txt", std::ofstream::out | std::ofstream::app); // append
+
+    for (unsigned m = 0; m < molsToValidate.size(); m++)
     {
-        if (!Validate(*m_it))
+        if (!Record(logfile, molsToValidate[m], maxTanimotos[m], maxIndices[m]))
         {
-            std::cerr << "Failed to validate: " << m_it->GetTitle() << std::endl;
+            std::cerr << "Failed to validate: " << molsToValidate[m].GetTitle() << std::endl;
         }
         else
         {
-            std::cerr << "Validated molecule #" << counter
-                      << ": " << m_it->GetTitle() << std::endl;
+            std::cerr << "Validated molecule #" << m + 1
+                      << ": " << molsToValidate[m].GetTitle() << std::endl;
         }
-        counter++;
     }
+
+    logfile.close();
 }
 
 
@@ -173,6 +217,8 @@ void Validator::Validate(const std::string& fileName)
     std::vector<OpenBabel::OBMol> molsToValidate;
    
     std::cerr << "Reading Validation file " << fileName << std::endl;
+
+    if (g_debug_output) std::cerr << "Fingerprint kernel: " << Fingerprint::Kernel() << std::endl;
  
     //
     // Read all of the OBMol objects using Open Babel; using their sample code style for reading.
@@ -20,28 +20,40 @@
 
 
 #include <vector>
+#include <string>
+#include <iostream>
 
 
 #include <openbabel/mol.h>
 
 
+#include "Fingerprint.h"
+
+
 //
 // A class to perform validation on the synthesis:
 //    Given (1) a hypergraph (formed from linkers and rigids)
 //          (2) a set of Open Babel molecules,
 //    Verify that the set of molecules are vertices in the hypergraph.
 //
+// The synthesized molecules are held as a fingerprint index, each fingerprint
+// computed once as the molecule was written. A list of molecules is searched
+// concurrently (Options::VALIDATE_THREADS).
+//
 class Validator
 {
   public:
-    Validator(std::vector<OpenBabel::OBMol*>& mols) : molecules(mols) {}
+    Validator(const FingerprintIndex& synthesized) : molecules(synthesized) {}
     bool Validate(OpenBabel::OBMol&);
     void Validate(const std::string& fileName);
     void Validate(std::vector<OpenBabel::OBMol>&);
 
   private:
 
-    std::vector<OpenBabel::OBMol*>& molecules; 
+    const FingerprintIndex& molecules;
+
+    bool Record(std::ostream& logfile, OpenBabel::OBMol& validationMol,
+                double maxTanimoto, int maxIndex) const;
 };
 
 #endif
@@ -0,0 +1,116 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+
+
+#include "BlockReader.h"
+
+
+//
+// Fragment assemblies print as: <fragment> then <atom>:<fragment>:<atom> per bond.
+//
+std::string FormatRecord(const std::string& record, unsigned encoding)
+{
+    if (encoding != BlockFormat::ENCODING_ASSEMBLY) return record;
+
+    const unsigned char* in = (const unsigned char*)record.data();
+    const unsigned char* end = in + record.size();
+
+    std::ostringstream oss;
+    unsigned value;
+    for (unsigned v = 0; GetVarint(in, end, value); v++)
+    {
+        if (v == 0) oss << value;
+        else oss << (v % 3 == 1 ? " " : ":") << value;
+    }
+
+    return oss.str();
+}
+
+//
+// Print the index of a seekable block file, or the molecules in an id range:
+//
+//    blockextract <file>.blk
+//    blockextract <file>.blk <first-id> [<last-id>]
+//
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4)
+    {
+        std::cerr << "Usage: blockextract <BLOCK-FILE>.blk [<first-id> [<last-id>]]" << std::endl;
+        return 1;
+    }
+
+    BlockReader reader;
+    if (!reader.open(argv[1])) return 1;
+
+    //
+    // Index summary
+    //
+    if (argc == 2)
+    {
+        std::cout << "Molecules " << reader.firstId() << " - " << reader.lastId()
+                  << " in " << reader.numBlocks() << " blocks" << std::endl;
+
+        std::cout << "Block\tFirst\tCount\tLevels\tOffset\tBytes" << std::endl;
+        for (unsigned b = 0; b < reader.numBlocks(); b++)
+        {
+            const BlockIndexEntry& entry = reader.block(b);
+
+            std::cout << b << "\t" << entry.firstId << "\t" << entry.count << "\t"
+                      << (unsigned)entry.minLevel << "-" << (unsigned)entry.maxLevel << "\t"
+                      << entry.offset << "\t" << entry.size << std::endl;
+        }
+
+        return 0;
+    }
+
+    //
+    // Molecules in [first, last]; only the blocks covering the range are decompressed.
+    //
+    unsigned long long first = strtoull(argv[2], NULL, 10);
+    unsigned long long last = argc == 4 ? strtoull(argv[3], NULL, 10) : first;
+
+    if (first < reader.firstId()) first = reader.firstId();
+    if (last > reader.lastId()) last = reader.lastId();
+
+    unsigned long long id = first;
+    while (id <= last)
+    {
+        int b = reader.findBlock(id);
+        if (b < 0) break;
+
+        std::vector<std::string> records;
+        if (!reader.readBlock(b, records)) return 1;
+
+        const BlockIndexEntry& entry = reader.block(b);
+        for ( ; id <= last && id < entry.firstId + records.size(); id++)
+        {
+            std::cout << FormatRecord(records[id - entry.firstId], reader.getEncoding()) << std::endl;
+        }
+
+        // Guard against a short block.
+        if (id < entry.firstId + entry.count) break;
+    }
+
+    return 0;
+}
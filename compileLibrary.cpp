@@ -0,0 +1,71 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+
+
+#include "FragmentLoader.h"
+#include "FragmentLibrary.h"
+#include "Rigid.h"
+#include "Linker.h"
+
+
+//
+// Parse the fragment SDF files once and store them as a precompiled library
+// for esynth -lib:
+//
+//    esynth-compile-library -o <library>.lib <linker sdfs> <rigid sdfs>
+//
+int main(int argc, char** argv)
+{
+    std::string outFile;
+    std::vector<std::string> inFiles;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outFile = argv[++i];
+        else inFiles.push_back(argv[i]);
+    }
+
+    if (outFile.empty() || inFiles.empty())
+    {
+        std::cerr << "Usage: esynth-compile-library -o <LIBRARY>" << FragmentLibrary::SUFFIX
+                  << " <SDF-FILES>" << std::endl;
+        return 1;
+    }
+
+    std::vector<Rigid*> rigids;
+    std::vector<Linker*> linkers;
+
+    if (!LoadFragmentFiles(inFiles, rigids, linkers)) return 1;
+
+    bool written = FragmentLibrary::Write(outFile, inFiles, rigids, linkers);
+
+    if (written)
+    {
+        std::cerr << "Wrote " << rigids.size() << " rigids and " << linkers.size()
+                  << " linkers to " << outFile << std::endl;
+    }
+
+    for (unsigned r = 0; r < rigids.size(); r++) delete rigids[r];
+    for (unsigned ell = 0; ell < linkers.size(); ell++) delete linkers[ell];
+
+    return written ? 0 : 1;
+}
@@ -47,6 +47,13 @@ GNU General Public License for more details.
 
 #include <sstream>
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <openbabel/babelconfig.h>
 #include <openbabel/base.h>
@@ -57,6 +64,7 @@ GNU General Public License for more details.
 
 
 #include "obgen.h"
+#include "Constants.h"
 
 
 //
@@ -80,6 +88,175 @@ class NullStream : public std::ostream
 };
 
 
+//
+// Each calling thread keeps its own synthobgen process (-stream), with a pipe
+// each way; the process ends when the thread exits and closes its requests.
+//
+struct ObgenWorker
+{
+    pid_t pid;
+    FILE* requests;
+    FILE* replies;
+};
+
+static pthread_key_t workerKey;
+static pthread_once_t workerOnce = PTHREAD_ONCE_INIT;
+static bool workerAvailable = false;
+
+static void EndWorker(ObgenWorker* worker)
+{
+    if (worker->pid < 0) return;
+
+    fclose(worker->requests);
+    fclose(worker->replies);
+    waitpid(worker->pid, NULL, 0);
+
+    worker->pid = -1;
+}
+
+static void DeleteWorker(void* worker_void)
+{
+    ObgenWorker* worker = static_cast<ObgenWorker*>(worker_void);
+
+    EndWorker(worker);
+    delete worker;
+}
+
+static void InitializeWorkerKey()
+{
+    pthread_key_create(&workerKey, DeleteWorker);
+
+    // A worker that dies must not take the synthesis with it: writes to it fail instead.
+    signal(SIGPIPE, SIG_IGN);
+
+    workerAvailable = access(OBGEN_EXE.c_str(), X_OK) == 0;
+}
+
+bool OBGen::Initialize()
+{
+    pthread_once(&workerOnce, InitializeWorkerKey);
+
+    if (!workerAvailable)
+    {
+        std::cerr << "obgen: cannot execute '" << OBGEN_EXE
+                  << "'; 3D output keeps the assembled coordinates." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Start a worker; its pid is -1 if it could not be started.
+//
+static ObgenWorker* StartWorker()
+{
+    ObgenWorker* worker = new ObgenWorker();
+    worker->pid = -1;
+
+    // Close-on-exec, so that no other thread's worker inherits these pipes.
+    int toWorker[2];
+    int fromWorker[2];
+    if (pipe2(toWorker, O_CLOEXEC) != 0) return worker;
+    if (pipe2(fromWorker, O_CLOEXEC) != 0)
+    {
+        close(toWorker[0]);
+        close(toWorker[1]);
+        return worker;
+    }
+
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Only async-signal-safe calls until exec: other threads may hold locks.
+        dup2(toWorker[0], STDIN_FILENO);
+        dup2(fromWorker[1], STDOUT_FILENO);
+        if (devNull >= 0) dup2(devNull, STDERR_FILENO);
+
+        execl(OBGEN_EXE.c_str(), OBGEN_EXE.c_str(), "-stream", (char*)0);
+        _exit(127);
+    }
+
+    close(toWorker[0]);
+    close(fromWorker[1]);
+    if (devNull >= 0) close(devNull);
+
+    if (pid < 0)
+    {
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        std::cerr << "obgen: could not start a worker." << std::endl;
+        return worker;
+    }
+
+    worker->pid = pid;
+    worker->requests = fdopen(toWorker[1], "w");
+    worker->replies = fdopen(fromWorker[0], "r");
+
+    return worker;
+}
+
+//
+// The calling thread's worker; started on first use and never restarted.
+//
+static ObgenWorker* ThreadWorker()
+{
+    pthread_once(&workerOnce, InitializeWorkerKey);
+    if (!workerAvailable) return 0;
+
+    ObgenWorker* worker = static_cast<ObgenWorker*>(pthread_getspecific(workerKey));
+    if (worker == 0)
+    {
+        worker = StartWorker();
+        pthread_setspecific(workerKey, worker);
+    }
+
+    return worker->pid < 0 ? 0 : worker;
+}
+
+bool OBGen::Generate(const std::string& sdf, bool posed, std::string& result)
+{
+    ObgenWorker* worker = ThreadWorker();
+    if (!worker) return false;
+
+    fputs(posed ? "pose\n" : "generate\n", worker->requests);
+    fputs(sdf.c_str(), worker->requests);
+    if (sdf.empty() || sdf[sdf.size() - 1] != '\n') fputc('\n', worker->requests);
+    fputs("$$$$\n", worker->requests);
+
+    if (fflush(worker->requests) == 0)
+    {
+        //
+        // The reply is one SDF record; only an empty one ("$$$$" alone) fails.
+        //
+        result.clear();
+
+        char buffer[256];
+        bool lineStart = true;
+        while (fgets(buffer, sizeof(buffer), worker->replies) != NULL)
+        {
+            if (lineStart && strncmp(buffer, "$$$$", 4) == 0)
+            {
+                bool read = !result.empty();
+                result += buffer;
+                return read;
+            }
+
+            result += buffer;
+            lineStart = buffer[strlen(buffer) - 1] == '\n';
+        }
+    }
+
+    // The worker has gone; this thread keeps the assembled coordinates from now on.
+    std::cerr << "obgen: worker " << worker->pid << " exited." << std::endl;
+    EndWorker(worker);
+
+    return false;
+}
+
+
 //
 // Original OBGEN: Generate rough 3D coordinates for SMILES (or other 0D files).
 //
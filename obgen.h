@@ -60,6 +60,19 @@ class OBGen
     static bool obgen(OpenBabel::OBMol* mol);
     static bool fast_obgen(OpenBabel::OBMol* mol);
 
+    //
+    // 3D coordinates for one SDF block (no "$$$$" line) of a synthesized
+    // molecule: generated from scratch as by the stand-alone synthobgen, or,
+    // if 'posed', only settled from the given coordinates. The work is done by
+    // a persistent synthobgen process (-stream) owned by the calling thread, so
+    // threads run concurrently and need no Open Babel lock. False, leaving
+    // 'result' unusable, if there is no worker or it could not read the molecule.
+    //
+    static bool Generate(const std::string& sdf, bool posed, std::string& result);
+
+    // Check for the worker executable once, before any thread uses it.
+    static bool Initialize();
+
   private:
     OBGen() {}
 };
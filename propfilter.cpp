@@ -0,0 +1,147 @@
+/*
+ *  This file is part of esynth.
+ *
+ *  esynth is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  esynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with esynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+
+#include "PropertyReader.h"
+
+
+struct Range
+{
+    int column;
+    float lo;
+    float hi;
+};
+
+int FindColumn(const char* name)
+{
+    for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+    {
+        if (strcmp(name, PropertyFormat::COLUMN_NAME[c]) == 0) return c;
+    }
+
+    return -1;
+}
+
+//
+// Print the block statistics of a property sidecar, or the ids of the molecules
+// whose properties fall in all of the given (inclusive) ranges:
+//
+//    propfilter <file>.props
+//    propfilter <file>.props <column> <min> <max> [<column> <min> <max> ...]
+//
+// Blocks whose min / max rule out a range are skipped without being read.
+//
+int main(int argc, char **argv)
+{
+    if (argc < 2 || (argc - 2) % 3 != 0)
+    {
+        std::cerr << "Usage: propfilter <PROPERTY-FILE>.props [<column> <min> <max>]..." << std::endl;
+        std::cerr << "Columns:";
+        for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+        {
+            std::cerr << " " << PropertyFormat::COLUMN_NAME[c];
+        }
+        std::cerr << std::endl;
+        return 1;
+    }
+
+    PropertyReader reader;
+    if (!reader.open(argv[1])) return 1;
+
+    //
+    // Block statistics
+    //
+    if (argc == 2)
+    {
+        std::cout << "Block\tFirst\tCount";
+        for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+        {
+            std::cout << "\t" << PropertyFormat::COLUMN_NAME[c];
+        }
+        std::cout << std::endl;
+
+        for (unsigned b = 0; b < reader.numBlocks(); b++)
+        {
+            const PropertyIndexEntry& entry = reader.block(b);
+
+            std::cout << b << "\t" << entry.firstId << "\t" << entry.count;
+            for (int c = 0; c < PropertyFormat::NUM_COLUMNS; c++)
+            {
+                std::cout << "\t" << entry.min[c] << "-" << entry.max[c];
+            }
+            std::cout << std::endl;
+        }
+
+        return 0;
+    }
+
+    std::vector<Range> ranges;
+    for (int a = 2; a < argc; a += 3)
+    {
+        Range range;
+        range.column = FindColumn(argv[a]);
+        range.lo = atof(argv[a + 1]);
+        range.hi = atof(argv[a + 2]);
+
+        if (range.column < 0)
+        {
+            std::cerr << "Unknown column: " << argv[a] << std::endl;
+            return 1;
+        }
+
+        ranges.push_back(range);
+    }
+
+    unsigned skipped = 0;
+    for (unsigned b = 0; b < reader.numBlocks(); b++)
+    {
+        bool possible = true;
+        for (unsigned r = 0; r < ranges.size() && possible; r++)
+        {
+            possible = reader.mayContain(b, ranges[r].column, ranges[r].lo, ranges[r].hi);
+        }
+
+        if (!possible)
+        {
+            skipped++;
+            continue;
+        }
+
+        const PropertyIndexEntry& entry = reader.block(b);
+        for (unsigned i = 0; i < entry.count; i++)
+        {
+            bool match = true;
+            for (unsigned r = 0; r < ranges.size() && match; r++)
+            {
+                float v = reader.value(b, ranges[r].column, i);
+                match = v >= ranges[r].lo && v <= ranges[r].hi;
+            }
+
+            if (match) std::cout << entry.firstId + i << std::endl;
+        }
+    }
+
+    std::cerr << "Skipped " << skipped << " of " << reader.numBlocks() << " blocks." << std::endl;
+
+    return 0;
+}
@@ -40,6 +40,9 @@ GNU General Public License for more details.
 #define USING_OBDLL
 #endif
 
+#include <iostream>
+#include <string>
+
 #include <openbabel/babelconfig.h>
 #include <openbabel/base.h>
 #include <openbabel/mol.h>
@@ -52,6 +55,78 @@ using namespace OpenBabel;
 
 // PROTOTYPES /////////////////////////////////////////////////////////////////
 
+static int stream(const char* program_name, const string& ff);
+
+///////////////////////////////////////////////////////////////////////////////
+//! \brief  Serve molecules from the synthesis program (see OBGen::Generate).
+//
+// Each request is a line, "generate" or "pose", followed by one SDF record up
+// to and including its "$$$$" line. "generate" builds coordinates from scratch
+// as below; "pose" keeps the given coordinates and only settles them. Each
+// reply is one SDF record, flushed at once; an empty record ("$$$$" alone)
+// means the molecule could not be read. End of input ends the process.
+//
+static int stream(const char* program_name, const string& ff)
+{
+  OBConversion conv;
+  if (!conv.SetInAndOutFormats("SDF", "SDF")) {
+    cerr << program_name << ": cannot read input/output format!" << endl;
+    return -1;
+  }
+
+  OBForceField* pFF = OBForceField::FindForceField(ff);
+  if (!pFF) {
+    cerr << program_name << ": could not find forcefield '" << ff << "'." <<endl;
+    return -1;
+  }
+
+  pFF->SetLogFile(&cerr);
+  pFF->SetLogLevel(OBFF_LOGLVL_LOW);
+
+  string command, line;
+  while (getline(cin, command)) {
+    string record;
+    while (getline(cin, line)) {
+      record += line;
+      record += '\n';
+      if (line.compare(0, 4, "$$$$") == 0)
+        break;
+    }
+
+    OBMol mol;
+    if (!conv.ReadString(&mol, record) || mol.Empty()) {
+      cout << "$$$$" << endl;
+      continue;
+    }
+
+    bool generate = (command != "pose");
+    if (generate) {
+      OBBuilder builder;
+      builder.Build(mol);
+    }
+
+    mol.AddHydrogens(false, true); // hydrogens must be added before Setup(mol) is called
+    if (pFF->Setup(mol)) {
+      if (generate) {
+        pFF->SteepestDescent(125, 1.0e-4);
+        pFF->WeightedRotorSearch(100, 25);
+        pFF->SteepestDescent(125, 1.0e-6);
+      }
+      else
+        pFF->ConjugateGradients(50, 1.0e-4);
+
+      pFF->UpdateCoordinates(mol);
+    }
+    else
+      cerr << program_name << ": could not setup force field." << endl;
+
+    conv.Write(&mol, &cout);
+    cout.flush();
+  }
+
+  return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //! \brief  Generate rough 3D coordinates for SMILES (or other 0D files).
 //
@@ -63,6 +138,7 @@ int main(int argc,char **argv)
 
   if (argc < 2) {
     cout << "Usage: obgen <filename> [options]" << endl;
+    cout << "       obgen -stream [options]" << endl;
     cout << endl;
     cout << "options:      description:" << endl;
     cout << endl;
@@ -71,18 +147,21 @@ int main(int argc,char **argv)
     OBPlugin::List("forcefields", "verbose");
     exit(-1);
   } else {
+    for (int i = 2; i < argc; i++) {
+      option = argv[i];
+      if ((option == "-ff") && (argc > (i+1)))
+        ff = argv[i+1];
+    }
+
+    if (string(argv[1]) == "-stream")
+      return stream(program_name, ff);
+
     basename = filename = argv[1];
     size_t extPos = filename.rfind('.');
 
     if (extPos!= string::npos) {
       basename = filename.substr(0, extPos);
     }
-
-    for (int i = 2; i < argc; i++) {
-      option = argv[i];
-      if ((option == "-ff") && (argc > (i+1)))
-        ff = argv[i+1];
-    }
   }
 
   // Find Input filetype
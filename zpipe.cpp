@@ -246,3 +246,171 @@ void zlib_compress(const std::string& infile, const std::string& outfile)
     fclose(fout);
 }
 
+
+
+//
+// Streaming compression: data is deflated as it is written, producing the
+// same (zlib) format as zlib_compress without an uncompressed copy on disk.
+//
+struct zlib_stream
+{
+    z_stream strm;
+    FILE* dest;
+    unsigned char out[CHUNK];
+};
+
+/* Run deflate() on the pending input until the output buffer is not full. */
+static int zlib_stream_deflate(zlib_stream* zs, int flush)
+{
+    int ret;
+    unsigned have;
+
+    do {
+        zs->strm.avail_out = CHUNK;
+        zs->strm.next_out = zs->out;
+        ret = deflate(&zs->strm, flush);    /* no bad return value */
+        assert(ret != Z_STREAM_ERROR);      /* state not clobbered */
+        have = CHUNK - zs->strm.avail_out;
+        if (fwrite(zs->out, 1, have, zs->dest) != have || ferror(zs->dest))
+            return Z_ERRNO;
+    } while (zs->strm.avail_out == 0);
+    assert(zs->strm.avail_in == 0);         /* all input will be used */
+
+    return Z_OK;
+}
+
+zlib_stream* zlib_stream_open(const std::string& outfile, int level)
+{
+    zlib_stream* zs = new zlib_stream;
+
+    zs->dest = fopen(outfile.c_str(), "wb");
+    if (zs->dest == NULL)
+    {
+        delete zs;
+        return 0;
+    }
+
+    /* allocate deflate state */
+    zs->strm.zalloc = Z_NULL;
+    zs->strm.zfree = Z_NULL;
+    zs->strm.opaque = Z_NULL;
+    int ret = deflateInit(&zs->strm, level);
+    if (ret != Z_OK)
+    {
+        zerr(ret);
+        fclose(zs->dest);
+        delete zs;
+        return 0;
+    }
+
+    return zs;
+}
+
+bool zlib_stream_write(zlib_stream* zs, const char* data, unsigned len)
+{
+    zs->strm.avail_in = len;
+    zs->strm.next_in = (Bytef*)data;
+
+    int ret = zlib_stream_deflate(zs, Z_NO_FLUSH);
+    if (ret != Z_OK) zerr(ret);
+
+    return ret == Z_OK;
+}
+
+bool zlib_stream_close(zlib_stream* zs)
+{
+    zs->strm.avail_in = 0;
+    zs->strm.next_in = Z_NULL;
+
+    int ret = zlib_stream_deflate(zs, Z_FINISH);
+    if (ret != Z_OK) zerr(ret);
+
+    (void)deflateEnd(&zs->strm);
+    fclose(zs->dest);
+    delete zs;
+
+    return ret == Z_OK;
+}
+
+
+/* Compress len bytes from source, appending a complete stream to dest: zlib
+   format, or a gzip member if gzip is set (concatenated gzip members form a
+   valid gzip file, so buffers may be compressed independently and in
+   parallel). Returns Z_OK on success or the zlib error as with def(). */
+int def_buffer(const char *source, unsigned len, std::string& dest, int level, bool gzip)
+{
+    int ret;
+    unsigned have;
+    z_stream strm;
+    unsigned char out[CHUNK];
+
+    /* allocate deflate state */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = deflateInit2(&strm, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK)
+        return ret;
+
+    dest.reserve(dest.size() + deflateBound(&strm, len));
+
+    /* the whole buffer is available; finish in one pass */
+    strm.avail_in = len;
+    strm.next_in = (Bytef*)source;
+    do {
+        strm.avail_out = CHUNK;
+        strm.next_out = out;
+        ret = deflate(&strm, Z_FINISH);    /* no bad return value */
+        assert(ret != Z_STREAM_ERROR);     /* state not clobbered */
+        have = CHUNK - strm.avail_out;
+        dest.append((const char*)out, have);
+    } while (strm.avail_out == 0);
+    assert(strm.avail_in == 0);     /* all input will be used */
+    assert(ret == Z_STREAM_END);    /* stream will be complete */
+
+    /* clean up and return */
+    (void)deflateEnd(&strm);
+    return Z_OK;
+}
+
+/* Decompress a complete zlib stream of len bytes from source, appending the
+   result to dest. Returns Z_OK on success or the zlib error as with inf(). */
+int inf_buffer(const char *source, unsigned len, std::string& dest)
+{
+    int ret;
+    unsigned have;
+    z_stream strm;
+    unsigned char out[CHUNK];
+
+    /* allocate inflate state */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = len;
+    strm.next_in = (Bytef*)source;
+    ret = inflateInit(&strm);
+    if (ret != Z_OK)
+        return ret;
+
+    /* run inflate() until the stream ends or the input is exhausted */
+    do {
+        strm.avail_out = CHUNK;
+        strm.next_out = out;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+        switch (ret) {
+        case Z_NEED_DICT:
+            ret = Z_DATA_ERROR;     /* and fall through */
+        case Z_DATA_ERROR:
+        case Z_MEM_ERROR:
+            (void)inflateEnd(&strm);
+            return ret;
+        }
+        have = CHUNK - strm.avail_out;
+        dest.append((const char*)out, have);
+    } while (ret != Z_STREAM_END && (strm.avail_out == 0 || strm.avail_in > 0));
+
+    /* clean up and return */
+    (void)inflateEnd(&strm);
+    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+}
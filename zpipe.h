@@ -18,7 +18,22 @@
 #ifndef _ZLIB_INTERFACE_GUARD
 #define _ZLIB_INTERFACE_GUARD 1
 
+#include <string>
+
 // Compress the given file to the given output file.
 void zlib_compress(const std::string& infile, const std::string& outfile);
 
+// Streaming compression to the given output file (same format as zlib_compress);
+// a level of -1 is the zlib default.
+struct zlib_stream;
+zlib_stream* zlib_stream_open(const std::string& outfile, int level = -1);
+bool zlib_stream_write(zlib_stream* stream, const char* data, unsigned len);
+bool zlib_stream_close(zlib_stream* stream);
+
+// Compress a buffer as a complete zlib stream (or gzip member), appended to dest.
+int def_buffer(const char* source, unsigned len, std::string& dest, int level = -1, bool gzip = false);
+
+// Decompress a complete zlib stream, appended to dest.
+int inf_buffer(const char* source, unsigned len, std::string& dest);
+
 #endif